@@ -0,0 +1,75 @@
+import argparse
+import json
+import os
+import subprocess
+
+c_source_file = "main.c"  # replace with the actual path if needed
+c_executable = "benchmark"
+results_file = "benchmark.json"  # replace with the actual path if needed
+repetitions = "5"  # every workload is run this many times on an empty highway
+
+# Workloads run in-process by the benchmark build of the program, unless others are given with --workload
+default_files = [f"TestCases/Open/open_{i}.txt" for i in range(1, 112) if os.path.exists(f"TestCases/Open/open_{i}.txt")]
+default_files.append("TestCases/Extra/open_extra_gen.txt")
+
+actions = ["ADDSTATION", "RMVSTATION", "ADDCAR", "RMVCAR", "PLANROUTE"]
+
+def compile_benchmark(source_file, output_file, defines):
+    # The benchmark build replaces main() with a driver that times every command
+    flags = [f"-DHIGHWAY_{name}" for name in defines]
+    result = subprocess.run(["gcc", "-O2", "-DHIGHWAY_BENCHMARK"] + flags + ["-o", output_file, source_file])
+
+    if result.returncode == 0:
+        print("Compilation successful!")
+    else:
+        print("Compilation failed!")
+        exit(1)  # Exit the script if compilation fails
+
+def run_benchmark(c_program, files):
+    result = subprocess.run([f"./{c_program}"] + files, capture_output=True, text=True,
+                            env=dict(os.environ, HIGHWAY_BENCHMARK_REPEAT=repetitions))
+    if result.returncode != 0:
+        print(f"Benchmark failed with return code {result.returncode}")
+        print(result.stderr)
+        exit(1)
+    return json.loads(result.stdout)
+
+def print_results(results, baseline=None):
+    print(f"\n{'action':<12}{'count':>10}{'per second':>14}{'p50 ns':>10}{'p99 ns':>10}")
+    for action in actions:
+        current = results["actions"][action]
+        line = f"{action:<12}{current['count']:>10}{current['per_second']:>14.0f}{current['p50_ns']:>10}{current['p99_ns']:>10}"
+        if baseline is not None and baseline["actions"][action]["p50_ns"] > 0 and current["p50_ns"] > 0:
+            # Ratios above 1 mean the command got slower than in the baseline
+            previous = baseline["actions"][action]
+            line += f"   p50 x{current['p50_ns'] / previous['p50_ns']:.2f}   p99 x{current['p99_ns'] / previous['p99_ns']:.2f}"
+        print(line)
+    if baseline is None:
+        return
+    # Whole workloads run in both, ratios above 1 mean the workload got slower
+    previous = {workload["file"]: workload["ns"] for workload in baseline["workloads"]}
+    for workload in results["workloads"]:
+        if previous.get(workload["file"], 0) > 0:
+            print(f"{workload['file']}: {previous[workload['file']] / 1e6:.1f} ms -> {workload['ns'] / 1e6:.1f} ms"
+                  f"   x{workload['ns'] / previous[workload['file']]:.2f}")
+
+# Usage: python3 Benchmark.py [--define NAME]... [--workload FILE]... [baseline.json]
+parser = argparse.ArgumentParser(description="Times every command of the workloads in a single process.")
+parser.add_argument("baseline", nargs="?", help="results of a previous run to compare with")
+parser.add_argument("--define", action="append", default=[], help="builds with -DHIGHWAY_<NAME>, for example JUMP_INDEX")
+parser.add_argument("--workload", action="append", default=[], help="workload to run instead of the test cases")
+args = parser.parse_args()
+
+baseline = None
+if args.baseline is not None:  # read before the results file is overwritten, it may be the same file
+    with open(args.baseline, "r") as previous:
+        baseline = json.load(previous)
+
+compile_benchmark(c_source_file, c_executable, args.define)
+results = run_benchmark(c_executable, args.workload or default_files)
+
+with open(results_file, "w") as report:
+    json.dump(results, report, indent=2)
+
+print_results(results, baseline)
+print(f"\nBenchmark completed! Results saved in {results_file}")
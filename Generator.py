@@ -0,0 +1,142 @@
+import argparse
+import os
+import random
+import subprocess
+
+c_source_file = "main.c"  # replace with the actual path if needed
+reference_executable = "reference"
+chunk_lines = 100000  # lines collected before they are written
+depot_cars = 512  # cars of a depot, the largest station allowed
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(description="Generates a workload of commands and its expected output.")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--stations", type=int, default=100000, help="stations added before the other operations")
+    parser.add_argument("--gap", type=int, default=16, help="average distance between two stations")
+    parser.add_argument("--ids", choices=["sequential", "shuffled", "uniform", "clustered"], default="uniform",
+                        help="sequential: evenly spaced and added in order, shuffled: evenly spaced and added in random "
+                             "order, uniform: random, clustered: runs of stations next to each other")
+    parser.add_argument("--cars", type=int, default=5, help="maximum number of cars of a new station")
+    parser.add_argument("--min-cars", type=int, default=1, help="minimum number of cars of a new station, one without cars blocks the routes crossing it")
+    parser.add_argument("--depots", type=float, default=0.001, help=f"fraction of new stations with {depot_cars} cars")
+    parser.add_argument("--range-max", type=float, default=8, help="largest car range, in gaps")
+    parser.add_argument("--pattern", choices=["random", "chain", "dense"], default="random",
+                        help="random: ranges up to --range-max, chain: every car reaches only the next evenly spaced "
+                             "station, so routes stop at every station, dense: every car reaches the whole highway, "
+                             "so every station of a level reaches the next one")
+    parser.add_argument("--operations", type=int, default=None, help="operations after the stations, stations / 10 by default")
+    parser.add_argument("--mix", default="1,1,2,2,4",
+                        help="weights of aggiungi-stazione, demolisci-stazione, aggiungi-auto, rottama-auto, pianifica-percorso")
+    parser.add_argument("--route-length", type=int, default=1000, help="stations between start and end of a route, 0 for any")
+    parser.add_argument("--reverse", type=float, default=0.5, help="fraction of routes towards the start of the highway")
+    parser.add_argument("--output", default=None, help="input file to write, TestCases/Extra/gen_<stations>_<seed>.txt by default")
+    parser.add_argument("--reference", default=None, help=f"program that writes the expected output, built from {c_source_file} by default")
+    parser.add_argument("--no-expected", action="store_true", help="do not write the expected output")
+    return parser.parse_args()
+
+def station_ids(args, rng):
+    span = args.stations * args.gap
+    if args.stations < 2:
+        print("At least two stations are needed")
+        exit(1)
+    if span >= 2 ** 32:
+        print("Too many stations for the gap, stationIDs must fit in 32 bits")
+        exit(1)
+    if args.ids == "sequential" or args.pattern == "chain" and args.ids != "shuffled":
+        return [i * args.gap for i in range(args.stations)]
+    if args.ids == "shuffled":
+        ids = [i * args.gap for i in range(args.stations)]
+        rng.shuffle(ids)
+        return ids
+    if args.ids == "uniform":
+        return rng.sample(range(span), args.stations)
+    # Runs of up to 1000 stations one unit apart, spread over the same span
+    ids = set()
+    while len(ids) < args.stations:
+        first = rng.randrange(span)
+        ids.update(range(first, min(first + rng.randint(1, 1000), span)))
+    ids = list(ids)[:args.stations]
+    rng.shuffle(ids)
+    return ids
+
+def car_range(args, rng, span):
+    if args.pattern == "chain":
+        return args.gap
+    if args.pattern == "dense":
+        return span
+    return rng.randint(0, int(args.range_max * args.gap))
+
+def car_ranges(args, rng, span):
+    count = depot_cars if rng.random() < args.depots else rng.randint(args.min_cars, args.cars)
+    return [car_range(args, rng, span) for _ in range(count)]
+
+def route_query(args, rng, stations):
+    # The program rejects routes from a station to itself, so start and end always differ
+    start = rng.randrange(len(stations) - 1)
+    if args.route_length > 0:
+        end = min(start + args.route_length, len(stations) - 1)
+    else:
+        end = rng.randrange(start + 1, len(stations))
+    low, high = sorted((stations[start], stations[end]))
+    return (high, low) if rng.random() < args.reverse else (low, high)
+
+def generate(args, path):
+    rng = random.Random(args.seed)
+    span = args.stations * args.gap
+    operations = args.operations if args.operations is not None else args.stations // 10
+    weights = [float(weight) for weight in args.mix.split(",")]
+    lines = []
+
+    with open(path, "w") as workload:
+        def emit(line):
+            lines.append(line)
+            if len(lines) == chunk_lines:
+                workload.write("\n".join(lines) + "\n")
+                lines.clear()
+
+        ids = station_ids(args, rng)
+        for station in ids:
+            cars = car_ranges(args, rng, span)
+            emit(f"aggiungi-stazione {station} {len(cars)} {' '.join(map(str, cars))}".rstrip())
+
+        # The routes and removals pick stations among the first ones, a station already removed is answered as missing
+        stations = sorted(ids)
+        for action in rng.choices(range(5), weights=weights, k=operations):
+            if action == 0:
+                station = rng.randrange(span)
+                cars = car_ranges(args, rng, span)
+                emit(f"aggiungi-stazione {station} {len(cars)} {' '.join(map(str, cars))}".rstrip())
+            elif action == 1:
+                emit(f"demolisci-stazione {rng.choice(stations)}")
+            elif action == 2:
+                emit(f"aggiungi-auto {rng.choice(stations)} {car_range(args, rng, span)}")
+            elif action == 3:
+                emit(f"rottama-auto {rng.choice(stations)} {car_range(args, rng, span)}")
+            else:
+                start, end = route_query(args, rng, stations)
+                emit(f"pianifica-percorso {start} {end}")
+        if lines:
+            workload.write("\n".join(lines) + "\n")
+
+def build_reference():
+    result = subprocess.run(["gcc", "-O2", "-o", reference_executable, c_source_file])
+    if result.returncode != 0:
+        print("Compilation failed!")
+        exit(1)
+    return f"./{reference_executable}"
+
+# Usage: python3 Generator.py [options], see python3 Generator.py --help
+args = parse_arguments()
+input_file = args.output or f"TestCases/Extra/gen_{args.stations}_{args.seed}.txt"
+generate(args, input_file)
+print(f"Workload written in {input_file}")
+
+if not args.no_expected:
+    expected_file = os.path.splitext(input_file)[0] + ".output.txt"
+    program = args.reference or build_reference()
+    with open(input_file, "r") as infile, open(expected_file, "w") as outfile:
+        result = subprocess.run([program], stdin=infile, stdout=outfile)
+    if result.returncode != 0:
+        print(f"Reference run failed with return code {result.returncode}")
+        exit(1)
+    print(f"Expected output written in {expected_file}")
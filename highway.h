@@ -0,0 +1,116 @@
+#ifndef HIGHWAY_H
+#define HIGHWAY_H
+
+/*
+ * Library interface of the highway. Every Highway is an independent context: different contexts can be used
+ * at the same time from different threads, while each context must be used by one thread at a time.
+ * Built with HIGHWAY_STATS the counters of the statistics are shared by the whole process, so while they are
+ * enabled only one context at a time can be used.
+ * The functions stop the process with the exit codes listed in main.c if memory cannot be allocated.
+ */
+
+/*
+ * Description: stations, cars and cached routes of a highway, its fields are private to the library
+ */
+typedef struct highway Highway;
+
+/*
+ * Function: createHighway
+ * Description: creates a highway with no stations
+ * Parameters: void
+ * Returns: pointer to the new highway, NULL if it could not be allocated
+ */
+Highway* createHighway();
+/*
+ * Function: freeHighway
+ * Description: frees a highway with all its stations and cars
+ * Parameters:
+ *   - highway: pointer to the highway, it can be NULL
+ * Returns: void
+ */
+void freeHighway(Highway* highway);
+/*
+ * Function: highwayAddStation
+ * Description: adds a station with its cars
+ * Parameters:
+ *   - highway: pointer to the highway
+ *   - stationID: distance of the station from the start of the highway
+ *   - cars: range of each car of the station
+ *   - numberOfCars: number of cars in cars
+ * Returns: 1 if the station was added, 0 if a station with the same ID already exists
+ */
+int highwayAddStation(Highway* highway, unsigned int stationID, const unsigned int* cars, int numberOfCars);
+/*
+ * Function: highwayRemoveStation
+ * Description: removes a station with all its cars
+ * Parameters:
+ *   - highway: pointer to the highway
+ *   - stationID: ID of the station
+ * Returns: 1 if the station was removed, 0 if it does not exist
+ */
+int highwayRemoveStation(Highway* highway, unsigned int stationID);
+/*
+ * Function: highwayAddCar
+ * Description: adds a car to a station
+ * Parameters:
+ *   - highway: pointer to the highway
+ *   - stationID: ID of the station
+ *   - carID: range of the car
+ * Returns: 1 if the car was added, 0 if the station does not exist
+ */
+int highwayAddCar(Highway* highway, unsigned int stationID, unsigned int carID);
+/*
+ * Function: highwayRemoveCar
+ * Description: removes a car with the given range from a station
+ * Parameters:
+ *   - highway: pointer to the highway
+ *   - stationID: ID of the station
+ *   - carID: range of the car
+ * Returns: 1 if the car was removed, 0 if the station does not exist or has no car with that range
+ */
+int highwayRemoveCar(Highway* highway, unsigned int stationID, unsigned int carID);
+/*
+ * Function: highwayPlanRoute
+ * Description: plans the route from the start station to the end station with the fewest stops, preferring the stops
+ *              closest to the start of the highway among the routes with as many stops
+ * Parameters:
+ *   - highway: pointer to the highway
+ *   - start: start station
+ *   - end: end station
+ *   - stops: array to store the stations of the route from start to end, it can be NULL if capacity is 0
+ *   - capacity: number of stations that fit in stops, only the first ones are stored if the route is longer
+ * Returns: number of stations in the route, 0 if there is no route
+ */
+int highwayPlanRoute(Highway* highway, unsigned int start, unsigned int end, unsigned int* stops, int capacity);
+/*
+ * Function: highwayCountStops
+ * Description: counts the stations of the route highwayPlanRoute would return without building it. When the library
+ *              is compiled with -DHIGHWAY_JUMP_INDEX this takes O(log n) once a run of queries with no change of the
+ *              stations has paid for rebuilding the index
+ * Parameters:
+ *   - highway: pointer to the highway
+ *   - start: start station
+ *   - end: end station
+ * Returns: number of stations in the route, 0 if there is no route
+ */
+int highwayCountStops(Highway* highway, unsigned int start, unsigned int end);
+/*
+ * Function: highwaySaveSnapshot
+ * Description: writes every station and its cars to a binary snapshot file
+ * Parameters:
+ *   - highway: pointer to the highway
+ *   - path: path of the snapshot file
+ * Returns: 1 if the snapshot was written, 0 otherwise
+ */
+int highwaySaveSnapshot(Highway* highway, const char* path);
+/*
+ * Function: highwayLoadSnapshot
+ * Description: fills a highway with no stations from a binary snapshot file
+ * Parameters:
+ *   - highway: pointer to the highway, it has no stations
+ *   - path: path of the snapshot file
+ * Returns: 1 if the snapshot was loaded, 0 if it could not be read or it is not valid
+ */
+int highwayLoadSnapshot(Highway* highway, const char* path);
+
+#endif
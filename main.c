@@ -1,20 +1,78 @@
 #include "stdio.h"
 #include "stdlib.h"
-#include "ctype.h"
+#include "string.h"
+#include "stddef.h"
+#include "errno.h"
+#include "stdint.h"
+#include "limits.h"
+#include "unistd.h"
+#include "fcntl.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+#if defined(HIGHWAY_BENCHMARK) || defined(HIGHWAY_STATS)
+#include "time.h"
+#endif
+#if defined(HIGHWAY_PARALLEL) || defined(HIGHWAY_PIPELINE)
+#include "pthread.h"
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include "immintrin.h"
+#endif
+#include "highway.h"
 
 /*
  * exit codes:
  *  5 - invalid action
- *  6 - heap is full
+ *  6 - car storage not allocated
  *  7 - vector not created
- *  8 - getValuesInRange failed
  *  9 - planRoute failed
- *  10 - isInRange failed (same station checked)
+ *  11 - pool slab not allocated
+ *  12 - benchmark workload not opened
+ *  13 - snapshot not loaded
+ *  14 - snapshot not saved
+ *  15 - highway not created
+ *  16 - jump index not allocated
 */
 
-#define BUFFER_SIZE 250 //size of the buffer to read from input
-#define MAX_SIZE_CARS 513 //maximum number of cars in a station
-#define VECTOR_SIZE_FACTOR 0.5 //factor to increase or decrease the initial size of the vector compared to the number of stations in the tree
+#define INPUT_BLOCK_SIZE (1 << 20) //size of the blocks read from input when it cannot be mapped
+#define OUTPUT_BUFFER_SIZE (1 << 16) //size of the buffer that collects the output before writing it
+#define MAX_UNSIGNED_DIGITS 10 //maximum number of digits of an unsigned int
+#define INLINE_CARS 6 //number of cars stored inside the maxHeap before it needs an external array
+#define INDEXED_CARS 24 //maxHeaps with a larger capacity keep a hash table from the range of each car to its position
+#define EMPTY_BUCKET (-1) //bucket of the car hash table that holds no car
+#if defined(__x86_64__) && defined(__GNUC__)
+#define CAR_SCAN_SIMD //fleets without a hash table are scanned with SSE2, or AVX2 when the processor has it
+#endif
+#define LEAF_SIZE 64 //maximum number of stations in a leaf of the station index
+#define INNER_SIZE 64 //maximum number of keys in an inner node of the station index
+#define MAX_TREE_HEIGHT 16 //maximum number of inner levels of the station index
+#define MAX_READERS 64 //maximum number of threads reading published versions of the station index at the same time
+#define FIRST_VERSION 2 //version of the first nodes of the station index, 0 and 1 mark the state of the readers
+#define POOL_SLAB_OBJECTS 1024 //number of objects carved out of every slab of a pool
+#define ROUTE_CACHE_BITS 8 //the route cache has 2^ROUTE_CACHE_BITS entries
+#define ROUTE_CACHE_MAX_STOPS 4096 //routes with more stops than this are not cached
+#define SNAPSHOT_MAGIC "HWYSNAP1" //first 8 bytes of a snapshot file
+#define PLANNER_INITIAL_SIZE 1024 //initial size of the vectors of the planner workspace, they double when full
+#ifdef HIGHWAY_JUMP_INDEX
+#define JUMP_INDEX_ARRAYS 10 //number of int arrays of a jump index, allocated in a single block
+#endif
+#ifdef HIGHWAY_PARALLEL
+#define QUERY_BATCH_SIZE 1024 //maximum number of consecutive route queries planned together
+#define MAX_WORKERS MAX_READERS //maximum number of threads planning the routes besides the main one
+#endif
+#ifdef HIGHWAY_PIPELINE
+#define COMMAND_RING_SIZE (1 << 16) //number of words in the ring of decoded commands, a power of two
+#define LAST_ON_LINE (1ULL << 32) //flag of the word of the last number of a line in the ring of decoded commands
+#define PIPELINE_SPINS 256 //times a thread of the pipeline checks the ring again before sleeping
+#endif
+#ifdef HIGHWAY_STATS
+#define STATS_BUCKETS 32 //the latency histograms have a bucket for each power of two of nanoseconds
+#define COUNT(counter, amount) (statistics.enabled ? (void) (statistics.counter += (amount)) : (void) 0) //adds amount to a counter of the statistics
+#define TIME_COMMAND(action) (statistics.enabled ? recordLatency(action) : (void) 0) //charges the time since the last command to action
+#else
+#define COUNT(counter, amount) ((void) 0) //the statistics are compiled out
+#define TIME_COMMAND(action) ((void) 0)
+#endif
 
 typedef enum action{
     ADDSTATION,
@@ -22,71 +80,50 @@ typedef enum action{
     ADDCAR,
     RMVCAR,
     PLANROUTE,
-    ENDINPUT
+    ENDINPUT,
+    INVALIDACTION
 }Action;
 /* Data Structures */
 /*
- * Description: Element of a linked list
+ * Description: input stream read in large blocks (or mapped in memory when it is a regular file)
  * Values:
- *  - minRange: sum of the maximum range of the cars in the station and the stationID
- *  - stationIndex: index of the station in the vector
+ *  - current: first character not consumed yet
+ *  - end: one past the last character available
+ *  - block: buffer used when the input is read in blocks, NULL until the first input that cannot be mapped
+ *  - mapping: first character of the mapped file, NULL when the input is read in blocks
+ *  - mappingLength: size of the mapped file
+ *  - fd: file descriptor of the input
+ *  - endOfFile: 1 if there is nothing left to read from fd, 0 otherwise
  */
-typedef struct Element {
-    int minRange;
-    int stationIndex;
-    int steps;
-    struct Element* next;
-} Element;
+typedef struct inputBuffer {
+    const char* current;
+    const char* end;
+    char* block;
+    const char* mapping;
+    size_t mappingLength;
+    int fd;
+    int endOfFile;
+} InputBuffer;
 /*
- * Description: pointer to an Element
- */
-typedef struct Element* pElement;
-/*
- * Description: LinkedList struct to store the stations in the route
- * Values:
- * - head: pointer to the first node
- */
-typedef struct LinkedList {
-    Element* head;
-    int bestMinRange;
-    int bestStationIndex;
-    int bestSteps;
-} LinkedList;
-/*
- * Description: pointer to a LinkedList
- */
-typedef struct LinkedList* pLinkedList;
-/*
- * Description: struct to store maxRange and stationIndex (used in planRoute)
- * Values:
- *   - maxRange: sum of the maximum range of the cars in the station and the stationID
- *   - second: index of the station in the vector
- *   - next: pointer to the next Entry
- */
-typedef struct entry {
-    unsigned int maxRange;
-    int stationIndex;
-    struct entry* next;
-}Entry;
-/*
- * Description: pointer to an entry
- */
-typedef struct entry* pEntry;
-/*
- * Description: struct to store a Queue
+ * Description: output stream collected in a buffer and written with a single call per flush
  * Values:
- *   - numberOfElements: number of elements in the queue
- *   - head: pointer to the first node
- *   - tail: pointer to the last node
+ *  - length: number of characters in the buffer
+ *  - fd: file descriptor of the output
+ *  - held: 1 if the characters flushed are kept in heldData instead of being written, 0 otherwise
+ *  - heldLength: number of characters in heldData
+ *  - heldCapacity: number of characters that fit in heldData
+ *  - heldData: characters flushed while the output was held
+ *  - data: characters not written yet
  */
-typedef struct queue {
-    pEntry head;
-    pEntry tail;
-}Queue;
-/*
- * Description: pointer to a queue
- */
-typedef struct queue* pQueue;
+typedef struct outputBuffer {
+    int length;
+    int fd;
+    int held;
+    size_t heldLength;
+    size_t heldCapacity;
+    char* heldData;
+    char data[OUTPUT_BUFFER_SIZE];
+} OutputBuffer;
 /*
  * Description: struct to store a vector
  * Values:
@@ -104,53 +141,570 @@ typedef struct vector {
  */
 typedef struct vector* pVector;
 /*
- * Description: maxHeap struct to store the cars in the station
+ * Description: memory used by the planners, it is allocated once and reset before every query so that
+ *              planning a route does not allocate once the vectors are large enough
+ * Values:
+ *   - levelEnds: for each number of steps, the station furthest from start reached with it
+ *   - route: stations of the route from start to end, empty if there is no route
+ *   - visited: stations and subtrees whose reach was read by the last route planned
+ */
+typedef struct plannerWorkspace {
+    pVector levelEnds;
+    pVector route;
+    unsigned long visited;
+}PlannerWorkspace;
+/*
+ * Description: maxHeap struct to store the cars in the station, small fleets live in inlineCars and larger ones in an array that doubles when full.
+ *              When the capacity is larger than INDEXED_CARS the array is followed in the same block by the position of each car
+ *              in the hash table (capacity ints) and by the hash table itself (a power of two of at least twice the capacity ints),
+ *              whose buckets hold the position of a car in the heap or EMPTY_BUCKET
  * Values:
  *   - numOfCars: number of cars in the station
- *   - array: array to store the cars
+ *   - capacity: number of cars that fit in array
+ *   - array: array to store the cars, it points to inlineCars until the fleet outgrows it
+ *   - inlineCars: storage for the first INLINE_CARS cars
  */
 typedef struct maxHeap {
     int numOfCars;
-    unsigned int array[MAX_SIZE_CARS];
+    int capacity;
+    unsigned int* array;
+    unsigned int inlineCars[INLINE_CARS];
 } MaxHeap;
 /*
  * Description: pointer to a MaxHeap
  */
 typedef struct maxHeap* pMaxHeap;
-/*
- * Description: enum to store the color of a node
- * Values:
- *   - RED: the node is red
- *   - BLACK: the node is black
- */
-typedef enum color {
-    RED,
-    BLACK
-}Color;
 /*
  * Description: pointer to a Station
  */
 typedef struct station* pStation;
 /*
- * Description: struct to store a station
+ * Description: struct to store a station, stations are stored by value in the leaves of the station index
+ *              so a pointer to a station is valid only until the next station is added or removed
  * Values:
- *   - pair1: ID of the station
+ *   - stationID: ID of the station
+ *   - forwardReach: furthest station reachable towards the end of the highway (stationID + maximum range of the cars)
+ *   - backwardReach: furthest station reachable towards the start of the highway (stationID - maximum range of the cars)
  *   - cars: pointer to the maxHeap of the station that stores the cars
- *   - color: color of the node
- *   - parent: pointer to the parent of the node
- *   - left: pointer to the left child of the node
- *   - right: pointer to the right child of the node
  */
 typedef struct station {
     unsigned int stationID;
+    unsigned int forwardReach;
+    int backwardReach;
     pMaxHeap cars;
-    Color color;
-    pStation parent;
-    pStation left;
-    pStation right;
 }Station;
+/*
+ * Description: pointer to a Leaf
+ */
+typedef struct leaf* pLeaf;
+/*
+ * Description: leaf of the station index, it stores a sorted run of stations contiguously
+ * Values:
+ *   - version: version of the station index the leaf was created in, it can be modified only while it is the current one
+ *   - numberOfStations: number of stations in the leaf
+ *   - stations: stations sorted by stationID
+ */
+typedef struct leaf {
+    unsigned long version;
+    int numberOfStations;
+    Station stations[LEAF_SIZE];
+}Leaf;
+/*
+ * Description: pointer to an InnerNode
+ */
+typedef struct innerNode* pInnerNode;
+/*
+ * Description: inner node of the station index
+ * Values:
+ *   - version: version of the station index the node was created in, it can be modified only while it is the current one
+ *   - numberOfKeys: number of keys in the node, the node has one more child
+ *   - keys: keys[i] is not greater than any stationID in children[i + 1] and greater than every stationID in children[i]
+ *   - forwardReach: forwardReach[i] is the largest forwardReach of the stations under children[i]
+ *   - backwardReach: backwardReach[i] is the smallest backwardReach of the stations under children[i]
+ *   - children: inner nodes or leaves (depending on the level) under this node
+ */
+typedef struct innerNode {
+    unsigned long version;
+    int numberOfKeys;
+    unsigned int keys[INNER_SIZE];
+    unsigned int forwardReach[INNER_SIZE + 1];
+    int backwardReach[INNER_SIZE + 1];
+    void* children[INNER_SIZE + 1];
+}InnerNode;
+/*
+ * Description: fixed size object allocator, objects are carved out of large slabs and recycled through a free list
+ * Values:
+ *   - name: name of the pool used when reporting its occupancy
+ *   - objectSize: size of each object, rounded up so that every object is aligned
+ *   - freeList: objects returned to the pool, each one stores the pointer to the next one in its first bytes
+ *   - slabs: list of the slabs allocated, each one stores the pointer to the previous one in its first bytes
+ *   - nextObject: first object of the current slab never handed out
+ *   - slabEnd: end of the current slab
+ *   - objectsInUse: number of objects handed out and not returned
+ *   - capacity: number of objects in all the slabs
+ */
+typedef struct pool {
+    const char* name;
+    size_t objectSize;
+    void* freeList;
+    void* slabs;
+    char* nextObject;
+    char* slabEnd;
+    unsigned int objectsInUse;
+    unsigned int capacity;
+} Pool;
+/*
+ * Description: root of a version of the station index published for the readers, it never changes once published
+ * Values:
+ *   - root: inner node or leaf (when height is 0) at the top of the tree, NULL if no station was ever added
+ *   - height: number of levels of inner nodes
+ *   - version: version of the station index
+ */
+typedef struct indexVersion {
+    void* root;
+    int height;
+    unsigned long version;
+}IndexVersion;
+/*
+ * Description: node or published version replaced by a newer version, it is released once no reader can reach it
+ * Values:
+ *   - object: the node or the version
+ *   - pool: pool the object comes from, NULL if it was allocated with malloc
+ *   - version: current version of the station index when the object was replaced, only older versions can reach it
+ */
+typedef struct retiredObject {
+    void* object;
+    Pool* pool;
+    unsigned long version;
+}RetiredObject;
+/*
+ * Description: inner nodes crossed to reach a leaf, used to fix the tree after a leaf is split or merged
+ * Values:
+ *   - nodes: nodes[0] is the root, nodes[height - 1] is the parent of the leaf
+ *   - childIndex: index of the child followed in each node
+ */
+typedef struct treePath {
+    pInnerNode nodes[MAX_TREE_HEIGHT];
+    int childIndex[MAX_TREE_HEIGHT];
+}TreePath;
+/*
+ * Description: B+tree storing the stations sorted by stationID. The tree is persistent: once a version is published,
+ *              its nodes are never modified again and the writer copies the path to a node before changing it,
+ *              so readers can plan routes on a published version while the stations keep changing.
+ *              Until a version is published every node belongs to the current one and is modified in place.
+ * Values:
+ *   - root: inner node or leaf (when height is 0) at the top of the tree, NULL if no station was ever added
+ *   - height: number of levels of inner nodes
+ *   - version: current version, the nodes created in it can be modified in place
+ *   - published: last version published for the readers, NULL if none was published
+ *   - readers: version held by each reader, 0 if it holds none and 1 while it is reading published
+ *   - retired: objects replaced by newer versions and not released yet, in the order they were replaced
+ *   - numberOfRetired: number of objects in retired
+ *   - retiredCapacity: number of objects that fit in retired
+ *   - numberOfStations: number of stations in the tree
+ *   - writeLeaf: leaf returned by the last call to writableLeaf, NULL once it leaves the tree
+ *   - writePath: inner nodes crossed to reach writeLeaf, used to update the reach kept for it when the cars of its stations change
+ *   - routes: route cache whose answers are dropped when the stations change
+ *   - leafPool: pool of the leaves
+ *   - innerPool: pool of the inner nodes
+ *   - carsPool: pool of the heaps storing the cars of the stations
+ */
+typedef struct stationIndex {
+    void* root;
+    int height;
+    unsigned long version;
+    IndexVersion* published;
+    unsigned long readers[MAX_READERS];
+    RetiredObject* retired;
+    int numberOfRetired;
+    int retiredCapacity;
+    unsigned int numberOfStations;
+    pLeaf writeLeaf;
+    TreePath writePath;
+    struct routeCache* routes;
+    Pool leafPool;
+    Pool innerPool;
+    Pool carsPool;
+}StationIndex;
+/*
+ * Description: pointer to a StationIndex
+ */
+typedef struct stationIndex* pStationIndex;
+/*
+ * Description: position of a station in the station index, used to walk the stations in order from any of them.
+ *              The leaves are not linked to each other, the cursor moves to the next leaf through the inner nodes above it.
+ * Values:
+ *   - leaf: leaf of the station
+ *   - slot: position of the station in the leaf
+ *   - height: number of levels of inner nodes
+ *   - path: inner nodes crossed to reach the leaf
+ */
+typedef struct stationCursor {
+    pLeaf leaf;
+    int slot;
+    int height;
+    TreePath path;
+}StationCursor;
+/*
+ * Description: range of stations searched by their reach in the station index, whole subtrees inside the range are
+ *              answered from the reach kept for them by their parent. The planners search ranges next to each other,
+ *              so the last leaf visited is remembered and a range that fits in it does not descend the tree again
+ * Values:
+ *   - low: smallest station of the range
+ *   - high: largest station of the range
+ *   - target: station to reach, used by findReachingInOrder and findReachingReverseOrder
+ *   - forwardReach: largest forwardReach in the range found by reachInNodeInOrder, 0 if the range has no station
+ *   - backwardReach: smallest backwardReach in the range found by reachInNodeReverseOrder, INT_MAX if the range has no station
+ *   - visited: stations and subtrees whose reach was read
+ *   - leaf: leaf remembered, NULL if none
+ *   - leafLow: smallest stationID that can be in leaf
+ *   - leafHigh: largest stationID that can be in leaf
+ */
+typedef struct reachRange {
+    unsigned int low;
+    unsigned int high;
+    unsigned int target;
+    unsigned int forwardReach;
+    int backwardReach;
+    unsigned long visited;
+    pLeaf leaf;
+    unsigned int leafLow;
+    unsigned int leafHigh;
+}ReachRange;
+
+/*
+ * Description: route stored in the route cache
+ * Values:
+ *   - start: start station of the route
+ *   - end: end station of the route
+ *   - numberOfStops: number of stations in the route, 0 if there is no route
+ *   - capacity: number of stations that fit in stops
+ *   - stops: stations of the route from start to end
+ */
+typedef struct routeCacheEntry {
+    unsigned int start;
+    unsigned int end;
+    int numberOfStops;
+    int capacity;
+    unsigned int* stops;
+} RouteCacheEntry;
+/*
+ * Description: direct mapped cache of the answers to pianifica-percorso, an entry is dropped as soon as a station
+ *              inside its interval is added, removed or changes its reach
+ * Values:
+ *   - low: smallest station of the interval of each entry, greater than high[i] when the entry is empty
+ *   - high: largest station of the interval of each entry
+ *   - entries: routes of the entries
+ *   - numberOfRoutes: number of entries in use
+ *   - coveredLow: smallest station covered by an entry in use
+ *   - coveredHigh: largest station covered by an entry in use
+ *   - hits: queries answered from the cache
+ *   - misses: queries that had to be planned
+ *   - invalidations: entries dropped because a station in their interval changed
+ *   - changes: number of stations added, removed or whose reach changed
+ */
+typedef struct routeCache {
+    unsigned int low[1 << ROUTE_CACHE_BITS];
+    unsigned int high[1 << ROUTE_CACHE_BITS];
+    RouteCacheEntry entries[1 << ROUTE_CACHE_BITS];
+    int numberOfRoutes;
+    unsigned int coveredLow;
+    unsigned int coveredHigh;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long invalidations;
+    unsigned long changes;
+} RouteCache;
+#ifdef HIGHWAY_JUMP_INDEX
+/*
+ * Description: stops of the routes in one direction of the highway, over the positions of the stations counted in the direction of travel.
+ *              Following parent from a position gives the fewest stops towards any position further on, jump skips ahead
+ *              along the parents so that the first parent that reaches a position is found in O(log n) steps.
+ * Values:
+ *   - reach: last position reachable from each position with one stop
+ *   - parent: position within reach that reaches furthest, the position itself if none reaches further than it
+ *   - jump: parent of a position several steps away, the position itself if it has no parent
+ *   - depth: number of steps from each position to the last parent of its chain
+ */
+typedef struct jumpChain {
+    int* reach;
+    int* parent;
+    int* jump;
+    int* depth;
+} JumpChain;
+/*
+ * Description: counts the stops of a route in O(log n) without planning it, rebuilt from the station index after it changes
+ * Values:
+ *   - stations: IDs of the stations in order, the start of the block of the arrays
+ *   - numberOfStations: number of stations in the index when it was built
+ *   - capacity: number of stations that fit in the arrays
+ *   - changes: changes of the route cache when the index was built, the index is stale when they differ
+ *   - work: reaches read by the planners since workChanges on queries the index would have answered by itself,
+ *           it is rebuilt when they cost as much as rebuilding it
+ *   - workChanges: changes of the route cache when work started, work restarts from 0 after every change
+ *   - forward: routes towards the end of the highway, positions counted from the start
+ *   - backward: routes towards the start of the highway, positions counted from the end
+ *   - stack: stations that reach further than all the ones before them, used while building the chains
+ */
+typedef struct jumpIndex {
+    unsigned int* stations;
+    int numberOfStations;
+    int capacity;
+    unsigned long changes;
+    unsigned long work;
+    unsigned long workChanges;
+    JumpChain forward;
+    JumpChain backward;
+    int* stack;
+} JumpIndex;
+#endif
+/*
+ * Description: context of a highway, declared in highway.h, every context is independent of the others
+ * Values:
+ *   - index: stations sorted by ID
+ *   - routes: answers to the last route queries
+ *   - planner: memory used to plan the routes
+ *   - jumps: number of stops of the routes, when compiled with -DHIGHWAY_JUMP_INDEX
+ */
+struct highway {
+    StationIndex index;
+    RouteCache routes;
+    PlannerWorkspace planner;
+#ifdef HIGHWAY_JUMP_INDEX
+    JumpIndex jumps;
+#endif
+};
+#ifdef HIGHWAY_PARALLEL
+/*
+ * Description: route query waiting to be answered in a batch
+ * Values:
+ *   - start: start station
+ *   - end: end station
+ *   - cached: 1 if the answer was found in the route cache, 0 if the route has to be planned
+ *   - visited: stations and subtrees whose reach was read to plan the route, counted in the statistics by the main thread
+ *   - route: stations of the route, the vector is kept for the next batches
+ */
+typedef struct routeQuery {
+    unsigned int start;
+    unsigned int end;
+    int cached;
+    unsigned long visited;
+    pVector route;
+}RouteQuery;
+/*
+ * Description: consecutive route queries, they are answered in the order they were read
+ * Values:
+ *   - numberOfQueries: number of queries in the batch
+ *   - changes: changes of the route cache when the batch was handed to the pool, the new routes are cached only if it did not change
+ *   - queries: queries of the batch in the order they were read
+ */
+typedef struct queryBatch {
+    int numberOfQueries;
+    unsigned long changes;
+    RouteQuery queries[QUERY_BATCH_SIZE];
+}QueryBatch;
+/*
+ * Description: pool of threads planning the routes of a batch on the last published version of the station index,
+ *              while the main thread keeps performing the next commands on a newer version
+ * Values:
+ *   - highway: highway the routes are planned on
+ *   - batch: batch being planned by the pool, NULL if the pool is idle
+ *   - collecting: position in batches of the batch collecting the queries read
+ *   - nextQuery: first query of the batch not taken by a thread yet
+ *   - numberOfWorkers: number of threads in the pool
+ *   - startedWorkers: number of threads that took their reader slot
+ *   - busyWorkers: threads still planning the current batch
+ *   - round: number of batches handed to the pool, a worker starts planning when it changes
+ *   - lock: protects busyWorkers and round
+ *   - started: signalled when a batch is handed to the pool
+ *   - finished: signalled when the last worker is done with a batch
+ *   - workers: threads of the pool
+ *   - owner: thread performing the commands, the only one adding and dispatching the queries
+ *   - batches: the batch being planned and the one collecting the next queries
+ */
+typedef struct plannerPool {
+    Highway* highway;
+    QueryBatch* batch;
+    int collecting;
+    int nextQuery;
+    int numberOfWorkers;
+    int startedWorkers;
+    int busyWorkers;
+    unsigned long round;
+    pthread_mutex_t lock;
+    pthread_cond_t started;
+    pthread_cond_t finished;
+    pthread_t workers[MAX_WORKERS];
+    pthread_t owner;
+    QueryBatch batches[2];
+}PlannerPool;
+#endif
+#ifdef HIGHWAY_PIPELINE
+/*
+ * Description: single producer single consumer ring of the commands decoded by the parser thread for the executor,
+ *              the thread performing them. A command is a word with its action followed by a word for each number
+ *              the executor reads for it with readInt, those ending a line marked with LAST_ON_LINE. Positions only
+ *              grow and are taken modulo COMMAND_RING_SIZE, the fields of each thread are on their own cache lines
+ * Values:
+ *   - written: words written by the parser, they become visible to the executor in head at the end of each command
+ *   - room: tail as last read by the parser
+ *   - head: words visible to the executor, written only by the parser
+ *   - parserWaiting: 1 while the parser sleeps waiting for room in the ring
+ *   - refilling: 1 while the parser waits for more input, the executor then writes the replies when it has no command left
+ *   - taken: words consumed by the executor, they are given back to the parser in tail at each command
+ *   - visible: head as last read by the executor
+ *   - tail: words given back to the parser, written only by the executor
+ *   - executorWaiting: 1 while the executor sleeps waiting for commands
+ *   - running: 1 while the commands are taken from the ring, 0 when they are read from the input directly
+ *   - lock: protects the sleep of both threads
+ *   - wakeUp: signalled when head or tail move while the other thread sleeps, or when the parser starts refilling
+ *   - parser: thread reading the input
+ *   - words: decoded commands
+ */
+typedef struct commandPipeline {
+    _Alignas(64) unsigned long written;
+    unsigned long room;
+    _Alignas(64) unsigned long head;
+    int parserWaiting;
+    int refilling;
+    _Alignas(64) unsigned long taken;
+    unsigned long visible;
+    _Alignas(64) unsigned long tail;
+    int executorWaiting;
+    int running;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeUp;
+    pthread_t parser;
+    _Alignas(64) uint64_t words[COMMAND_RING_SIZE];
+}CommandPipeline;
+#endif
+#ifdef HIGHWAY_STATS
+/*
+ * Description: counters of the work done by the hot paths, collected only when the program is built with HIGHWAY_STATS
+ *              and HIGHWAY_STATS_FILE names the file they are written to at exit
+ * Values:
+ *   - enabled: 1 if the counters are collected, 0 otherwise
+ *   - path: file the counters are written to
+ *   - leafSplits, innerSplits, rootSplits: nodes of the station index split by addStation
+ *   - leafBorrows, innerBorrows: stations or children moved between siblings by removeStation
+ *   - leafMerges, innerMerges, rootCollapses: nodes of the station index removed by removeStation
+ *   - siftUpSteps: swaps with the parent done by addCar and removeCar
+ *   - siftDownSteps: swaps with a child done by restoreHeapProperty
+ *   - carScans: calls to removeCar
+ *   - carScanLength: cars compared by removeCar while searching the car to remove, in the heap or in its hash table
+ *   - routesPlanned: routes planned because they were not in the route cache
+ *   - reachesRead: reaches of stations and of whole subtrees read by the planners from the station index
+ *   - latency: for each action, number of commands that took less than 2^i nanoseconds (and at least 2^(i - 1))
+ *   - commandEnd: instant the last command was timed at, the next one is timed from it
+ */
+typedef struct statistics {
+    int enabled;
+    const char* path;
+    unsigned long leafSplits;
+    unsigned long innerSplits;
+    unsigned long rootSplits;
+    unsigned long leafBorrows;
+    unsigned long innerBorrows;
+    unsigned long leafMerges;
+    unsigned long innerMerges;
+    unsigned long rootCollapses;
+    unsigned long siftUpSteps;
+    unsigned long siftDownSteps;
+    unsigned long carScans;
+    unsigned long carScanLength;
+    unsigned long routesPlanned;
+    unsigned long reachesRead;
+    unsigned long latency[ENDINPUT][STATS_BUCKETS];
+    struct timespec commandEnd;
+} Statistics;
+#endif
 
 /* Function Declarations */
+#ifndef HIGHWAY_LIBRARY
+/*
+ * Function: initInput
+ * Description: prepares the input layer to read from the given file descriptor, mapping it in memory when it is a regular file
+ * Parameters:
+ *   - fd: file descriptor to read from
+ * Returns: void
+ */
+void initInput(int fd);
+/*
+ * Function: releaseInput
+ * Description: unmaps the current input if it was mapped in memory, the block buffer is kept for the next input
+ * Parameters: void
+ * Returns: void
+ */
+void releaseInput();
+/*
+ * Function: refillInput
+ * Description: moves the characters not consumed yet to the beginning of the block and reads the next block after them
+ * Returns: 0 if nothing else could be read, 1 otherwise
+ */
+int refillInput();
+/*
+ * Function: nextToken
+ * Description: finds the next token in the input without copying it, the token is always contiguous in memory
+ * Parameters:
+ *   - length: pointer to store the length of the token
+ *   - terminator: pointer to store the character that ends the token (EOF if the input is over)
+ * Returns: pointer to the first character of the token
+ */
+const char* nextToken(int* length, int* terminator);
+/*
+ * Function: parseDigits
+ * Description: converts a string of digits to an unsigned int, eight digits at a time when possible
+ * Parameters:
+ *   - digits: pointer to the first digit
+ *   - length: number of digits
+ * Returns: the converted number
+ */
+unsigned int parseDigits(const char* digits, int length);
+/*
+ * Function: flushOutput
+ * Description: writes all the characters in the output buffer
+ * Parameters: void
+ * Returns: void
+ */
+void flushOutput();
+/*
+ * Function: holdOutput
+ * Description: writes the output buffer and keeps the characters written from now on aside, until writeHeldOutput
+ * Parameters: void
+ * Returns: void
+ */
+void holdOutput();
+/*
+ * Function: writeHeldOutput
+ * Description: appends the characters kept aside while the output was held to the output buffer
+ * Parameters: void
+ * Returns: void
+ */
+void writeHeldOutput();
+/*
+ * Function: writeText
+ * Description: appends a string to the output buffer, flushing it when it is full
+ * Parameters:
+ *   - text: null terminated string to write
+ * Returns: void
+ */
+void writeText(const char* text);
+/*
+ * Function: writeUnsigned
+ * Description: appends the decimal representation of a number to the output buffer, flushing it when it is full
+ * Parameters:
+ *   - value: number to write
+ * Returns: void
+ */
+void writeUnsigned(unsigned int value);
+/*
+ * Function: writeChar
+ * Description: appends a character to the output buffer, flushing it when it is full
+ * Parameters:
+ *   - character: character to write
+ * Returns: void
+ */
+void writeChar(char character);
 /*
  * Function: readInt
  * Description: reads int from input stream
@@ -166,72 +720,141 @@ int readInt(unsigned int *number);
  */
 Action readAction();
 /*
- * Function: newLinkedList
- * Description: creates a new linked list
+ * Function: decodeAction
+ * Description: finds the action named by a token of the input
+ * Parameters:
+ *   - token: pointer to the first character of the token
+ *   - length: length of the token
+ * Returns: the action, INVALIDACTION if the token names none
+ */
+Action decodeAction(const char* token, int length);
+/*
+ * Function: writeReplies
+ * Description: writes the replies of every command performed so far, before the program waits for more input or exits
  * Parameters: void
- * Returns: pointer to the new linked list
+ * Returns: void
+ */
+void writeReplies();
+#ifdef HIGHWAY_PIPELINE
+/*
+ * Function: startPipeline
+ * Description: starts the parser thread, which decodes the input into the ring while the commands are performed,
+ *              unless HIGHWAY_PIPELINE is 0 or, when it is not set, there is a single processor
+ * Parameters:
+ *   - pipeline: pointer to the pipeline
+ * Returns: 1 if the parser thread started, 0 if the commands are read from the input directly
  */
-pLinkedList newLinkedList();
+int startPipeline(CommandPipeline* pipeline);
 /*
- * Function: createElement
- * Description: creates a new element
+ * Function: stopPipeline
+ * Description: waits for the parser thread after the end of the input was taken from the ring
  * Parameters:
- *  - minRange: sum of the maximum range of the cars in the station and the stationID
- *  - stationIndex: index of the station in the vector
- *  Returns: pointer to the new element
+ *   - pipeline: pointer to the pipeline
+ * Returns: void
  */
-pElement createElement(int minRange, int stationIndex, int steps);
+void stopPipeline(CommandPipeline* pipeline);
 /*
- * Function: insertLinked
- * Description: inserts a new element in the linked list
+ * Function: runParser
+ * Description: body of the parser thread, decodes every command of the input into the ring up to the end of the input
+ *              or the first invalid action
  * Parameters:
- *  - list: pointer to the linked list
- *  - minRange: sum of the maximum range of the cars in the station and the stationID
- *  - stationIndex: index of the station in the vector
- *  Returns: void
+ *   - argument: pointer to the pipeline
+ * Returns: NULL
  */
-void insertLinked(LinkedList *list, int minRange, int stationIndex, int steps);
+void* runParser(void* argument);
 /*
- * Function: freeLinkedList
- * Description: frees the memory allocated for the linked list
+ * Function: putNumber
+ * Description: decodes the next token of the input as readInt does and appends it to the ring
  * Parameters:
- *  - list: pointer to the linked list to free
- *  Returns: void
+ *   - pipeline: pointer to the pipeline
+ * Returns: 0 if the number ends the line or the input, 1 otherwise, as readInt
  */
-void freeLinkedList(LinkedList* list);
+int putNumber(CommandPipeline* pipeline);
 /*
- * Function: newQueue
- * Description: creates a new queue
- * Parameters: void
- * Returns: pointer to the new queue
+ * Function: putWord
+ * Description: appends a word to the ring, waiting for room if it is full
+ * Parameters:
+ *   - pipeline: pointer to the pipeline
+ *   - word: word to append
+ * Returns: void
+ */
+void putWord(CommandPipeline* pipeline, uint64_t word);
+/*
+ * Function: publishWords
+ * Description: makes the words written by the parser visible to the executor, waking it if it sleeps
+ * Parameters:
+ *   - pipeline: pointer to the pipeline
+ * Returns: void
+ */
+void publishWords(CommandPipeline* pipeline);
+/*
+ * Function: waitForRoom
+ * Description: waits until the executor gives back some words of the full ring
+ * Parameters:
+ *   - pipeline: pointer to the pipeline
+ * Returns: void
+ */
+void waitForRoom(CommandPipeline* pipeline);
+/*
+ * Function: setRefilling
+ * Description: tells the executor whether the parser is waiting for more input, so that it writes the replies
+ *              once it has no command left
+ * Parameters:
+ *   - pipeline: pointer to the pipeline
+ *   - refilling: 1 before the parser reads more input, 0 after
+ * Returns: void
+ */
+void setRefilling(CommandPipeline* pipeline, int refilling);
+/*
+ * Function: takeWord
+ * Description: takes the next word from the ring, waiting for the parser if it is empty
+ * Parameters:
+ *   - pipeline: pointer to the pipeline
+ * Returns: the word
+ */
+uint64_t takeWord(CommandPipeline* pipeline);
+/*
+ * Function: waitForWords
+ * Description: waits until the parser publishes more words, writing the replies if the parser waits for input
+ * Parameters:
+ *   - pipeline: pointer to the pipeline
+ * Returns: void
+ */
+void waitForWords(CommandPipeline* pipeline);
+/*
+ * Function: giveBackWords
+ * Description: gives the words taken by the executor back to the parser, waking it if it waits for room
+ * Parameters:
+ *   - pipeline: pointer to the pipeline
+ * Returns: void
  */
-pQueue newQueue();
+void giveBackWords(CommandPipeline* pipeline);
+#endif
+#endif
 /*
- * Function: enqueue
- * Description: adds a new element to the queue
+ * Function: initPlannerWorkspace
+ * Description: allocates the vectors of the planner workspace
  * Parameters:
- *   - queue: pointer to the queue
- *   - maxRange: sum of the maximum range of the cars in the station and the stationID
- *   - stationIndex: index of the station in the vector
+ *   - workspace: pointer to the planner workspace
  * Returns: void
  */
-void enqueue(pQueue queue, int maxRange, int stationIndex);
+void initPlannerWorkspace(PlannerWorkspace* workspace);
 /*
- * Function: dequeue
- * Description: removes the first element from the queue
+ * Function: resetPlannerWorkspace
+ * Description: empties the vectors of the planner workspace, keeping their memory
  * Parameters:
- *   - queue: pointer to the queue
- * Returns: pointer to the removed element
+ *   - workspace: pointer to the planner workspace
+ * Returns: void
  */
-pEntry dequeue(pQueue queue);
+void resetPlannerWorkspace(PlannerWorkspace* workspace);
 /*
- * Function: freeQueue
- * Description: frees the memory allocated for the queue
+ * Function: freePlannerWorkspace
+ * Description: frees the vectors of the planner workspace
  * Parameters:
- *   - queue: pointer to the queue to free
+ *   - workspace: pointer to the planner workspace
  * Returns: void
  */
-void freeQueue(pQueue queue);
+void freePlannerWorkspace(PlannerWorkspace* workspace);
 /*
  * Function: newVector
  * Description: creates a new vector
@@ -254,801 +877,3128 @@ void freeVector(Vector* vector);
  * Returns: 1 if the element was added, 0 otherwise
  */
 int addVector(Vector *vector, unsigned int value);
+/*
+ * Function: poolAlloc
+ * Description: takes an object from the pool, reusing a returned one if possible and allocating a new slab if needed
+ * Parameters:
+ *   - pool: pointer to the pool
+ * Returns: pointer to the object
+ */
+void* poolAlloc(Pool* pool);
+/*
+ * Function: poolFree
+ * Description: returns an object to the pool so that it can be reused
+ * Parameters:
+ *   - pool: pointer to the pool
+ *   - object: pointer to the object to return
+ * Returns: void
+ */
+void poolFree(Pool* pool, void* object);
+/*
+ * Function: releasePool
+ * Description: frees every slab of the pool, the objects taken from it must not be used anymore
+ * Parameters:
+ *   - pool: pointer to the pool
+ * Returns: void
+ */
+void releasePool(Pool* pool);
+/*
+ * Function: reverseVector
+ * Description: reverses the order of the elements of the vector
+ * Parameters:
+ *   - vector: pointer to the vector
+ * Returns: void
+ */
+void reverseVector(Vector* vector);
 /*
  * Function: createMaxHeap
  * Description: creates a new maxHeap
- * Parameters: void
+ * Parameters:
+ *   - index: pointer to the station index whose pool provides the maxHeap
  * Returns: pointer to the new maxHeap
  */
-pMaxHeap createMaxHeap();
+pMaxHeap createMaxHeap(pStationIndex index);
 /*
- * Function: addCar
- * Description: adds a new car to the maxHeap
+ * Function: freeMaxHeap
+ * Description: returns a maxHeap to its pool, releasing the external array if it has one
  * Parameters:
+ *   - index: pointer to the station index whose pool provided the maxHeap
  *   - maxHeap: pointer to the maxHeap
- *   - carID: ID of the new car
  * Returns: void
  */
-void addCar(pMaxHeap maxHeap, unsigned int carID);
+void freeMaxHeap(pStationIndex index, pMaxHeap maxHeap);
 /*
- * Function: removeCar
- * Description: removes a car from the maxHeap
+ * Function: growMaxHeap
+ * Description: doubles the capacity of the maxHeap, moving the cars to a larger array
  * Parameters:
  *   - maxHeap: pointer to the maxHeap
- *   - element: id of the car to remove
- * Returns: 1 if the car was removed, 0 otherwise
+ * Returns: void
  */
-int removeCar(MaxHeap* maxHeap, unsigned int carID);
+void growMaxHeap(pMaxHeap maxHeap);
 /*
- * Function: restoreHeapProperty
- * Description: restores the heap property of the maxHeap
+ * Function: allocateCars
+ * Description: allocates the external array of a maxHeap, followed by the room for the hash table of its cars if the capacity needs it
  * Parameters:
- *   - maxHeap: pointer to the maxHeap
- *   - index: index to start restoring the heap property
+ *   - capacity: number of cars that fit in the array
+ * Returns: pointer to the new array
+ */
+unsigned int* allocateCars(int capacity);
+/*
+ * Function: carIndexBits
+ * Description: size of the hash table of the cars of a maxHeap with the given capacity
+ * Parameters:
+ *   - capacity: capacity of the maxHeap
+ * Returns: base 2 logarithm of the number of buckets, 0 if the maxHeap has no hash table
+ */
+int carIndexBits(int capacity);
+/*
+ * Function: carBucket
+ * Description: home bucket of a car in the hash table of a maxHeap
+ * Parameters:
+ *   - carID: range of the car
+ *   - bits: base 2 logarithm of the number of buckets
+ * Returns: position of the bucket
+ */
+unsigned int carBucket(unsigned int carID, int bits);
+/*
+ * Function: buildCarIndex
+ * Description: fills the hash table of a maxHeap with all its cars
+ * Parameters:
+ *   - maxHeap: pointer to the maxHeap, its capacity is larger than INDEXED_CARS
  * Returns: void
  */
-void restoreHeapProperty(MaxHeap* maxHeap, int idx);
+void buildCarIndex(pMaxHeap maxHeap);
 /*
- * Function: createNode
- * Description: generates a new station with the given pair1 for the red-black tree
+ * Function: indexCar
+ * Description: adds the car in the given position of the heap to the hash table
  * Parameters:
- *   - pair1: pair1 of the new station
- * Returns: pointer to the new station
+ *   - maxHeap: pointer to the maxHeap, its capacity is larger than INDEXED_CARS
+ *   - slot: position of the car in the heap
+ * Returns: void
  */
-pStation createNode(unsigned int stationID);
+void indexCar(pMaxHeap maxHeap, int slot);
 /*
- * Function: rightRotate
- * Description: performs a right rotation on the given station
+ * Function: unindexCar
+ * Description: removes the car in the given position of the heap from the hash table, shifting back the cars
+ *              that collided with it so that no tombstone is left
  * Parameters:
- *   - root: pointer to the root of the tree
- *   - station: station to perform the rotation
+ *   - maxHeap: pointer to the maxHeap, its capacity is larger than INDEXED_CARS
+ *   - slot: position of the car in the heap
  * Returns: void
  */
-void rightRotate(pStation *root, pStation node);
+void unindexCar(pMaxHeap maxHeap, int slot);
+/*
+ * Function: findCar
+ * Description: finds a car with the given range, with the hash table if the maxHeap has one and by scanning the heap otherwise
+ * Parameters:
+ *   - maxHeap: pointer to the maxHeap
+ *   - carID: range of the car
+ * Returns: position of the car in the heap, -1 if there is none
+ */
+int findCar(pMaxHeap maxHeap, unsigned int carID);
+/*
+ * Function: scanCars
+ * Description: finds the first car with the given range in an array, with the widest kernel the processor supports
+ * Parameters:
+ *   - cars: range of each car
+ *   - numberOfCars: number of cars in cars
+ *   - carID: range of the car
+ * Returns: position of the car, -1 if there is none
+ */
+int scanCars(const unsigned int* cars, int numberOfCars, unsigned int carID);
+/*
+ * Function: scanCarsScalar
+ * Description: scanCars comparing one car at a time, used when no vector kernel is available
+ * Parameters:
+ *   - cars: range of each car
+ *   - numberOfCars: number of cars in cars
+ *   - carID: range of the car
+ * Returns: position of the car, -1 if there is none
+ */
+int scanCarsScalar(const unsigned int* cars, int numberOfCars, unsigned int carID);
+#ifdef CAR_SCAN_SIMD
+/*
+ * Function: scanCarsSse2
+ * Description: scanCars comparing four cars per instruction, SSE2 is part of every x86-64 processor. numberOfCars is at least 4
+ * Parameters:
+ *   - cars: range of each car
+ *   - numberOfCars: number of cars in cars
+ *   - carID: range of the car
+ * Returns: position of the car, -1 if there is none
+ */
+int scanCarsSse2(const unsigned int* cars, int numberOfCars, unsigned int carID);
+/*
+ * Function: scanCarsAvx2
+ * Description: scanCars comparing eight cars per instruction, it must only run on processors with AVX2. numberOfCars is at least 8
+ * Parameters:
+ *   - cars: range of each car
+ *   - numberOfCars: number of cars in cars
+ *   - carID: range of the car
+ * Returns: position of the car, -1 if there is none
+ */
+int scanCarsAvx2(const unsigned int* cars, int numberOfCars, unsigned int carID);
+#endif
 /*
- * Function: leftRotate
- * Description: performs a left rotation on the given station
+ * Function: moveCar
+ * Description: moves a car to another position of the heap, keeping the hash table up to date
  * Parameters:
- *   - root: pointer to the root of the tree
- *   - station: station to perform the rotation
+ *   - maxHeap: pointer to the maxHeap
+ *   - from: current position of the car
+ *   - to: new position of the car, the car there is overwritten
  * Returns: void
  */
-void leftRotate(pStation *root, pStation node);
+void moveCar(pMaxHeap maxHeap, int from, int to);
 /*
- * Function: insertFix
- * Description: checks if any rotation is needed after inserting a new station
+ * Function: swapCars
+ * Description: swaps two cars of the heap, keeping the hash table up to date
  * Parameters:
- *   - root: pointer to the root of the tree
- *   - station: station to check if any rotation is needed
+ *   - maxHeap: pointer to the maxHeap
+ *   - first: position of the first car
+ *   - second: position of the second car
  * Returns: void
  */
-void insertFix(pStation *root, pStation node);
+void swapCars(pMaxHeap maxHeap, int first, int second);
 /*
- * Function: addStation
- * Description: inserts a new station in the tree
+ * Function: updateReach
+ * Description: recomputes the reach of the station from the maximum range of its cars, dropping the cached routes if it changed
  * Parameters:
- *   - root: pointer to the root of the tree
- *   - pair1: pair1 of the new station
- * Returns: pointer to the new station if it was added, NULL otherwise
+ *   - index: pointer to the station index of the station
+ *   - station: pointer to the station
+ * Returns: void
  */
-pStation addStation(pStation *root, unsigned  int stationID);
+void updateReach(pStationIndex index, pStation station);
 /*
- * Function: removeStation
- * Description: removes a station from the tree
+ * Function: addCar
+ * Description: adds a new car to the maxHeap of the station and updates its reach
  * Parameters:
- *   - root: pointer to the root of the tree
- *   - pair1: of the station to remove
- * Returns: 1 if the station was removed, 0 otherwise
+ *   - index: pointer to the station index of the station
+ *   - station: pointer to the station
+ *   - carID: ID of the new car
+ * Returns: void
+ */
+void addCar(pStationIndex index, pStation station, unsigned int carID);
+/*
+ * Function: removeCar
+ * Description: removes a car from the maxHeap of the station and updates its reach
+ * Parameters:
+ *   - index: pointer to the station index of the station
+ *   - station: pointer to the station
+ *   - element: id of the car to remove
+ * Returns: 1 if the car was removed, 0 otherwise
  */
-int removeStation(pStation* root, unsigned int stationID);
+int removeCar(pStationIndex index, pStation station, unsigned int carID);
 /*
- * Function: fixDelete
- * Description: checks if any rotation is needed after removing a station
+ * Function: restoreHeapProperty
+ * Description: restores the heap property of the maxHeap
  * Parameters:
- *   - root: pointer to the root of the tree
- *   - station: station to check if any rotation is needed
- *   - parent: parent of the station
+ *   - maxHeap: pointer to the maxHeap
+ *   - index: index to start restoring the heap property
  * Returns: void
  */
-void fixDelete(pStation* root, pStation node, pStation parent);
+void restoreHeapProperty(MaxHeap* maxHeap, int idx);
 /*
- * Function: searchStation
- * Description: searches for a station in the tree
+ * Function: createLeaf
+ * Description: generates a new empty leaf for the station index, in its current version
  * Parameters:
- *   - root: pointer to the root of the tree
- *   - station: station to search
- * Returns: pointer to the station if found, NULL otherwise
+ *   - index: pointer to the station index
+ * Returns: pointer to the new leaf
  */
-pStation searchStation(pStation* root, unsigned int stationID);
+pLeaf createLeaf(pStationIndex index);
 /*
- * Function: planRouteInOrder
- * Description:  The function uses an in-order traversal of a Red-Black Tree of stations, considering only those within the desired range.
- *               At each station, it checks if the station is reachable based on the current maximum range.
- *               If the station is reachable, it updates the current maximum range and maintains a priority queue of possible routes.
- *               If the current maximum range cannot reach the next station, it dequeues the next possible route until a viable route is found or the queue is empty.
+ * Function: createInnerNode
+ * Description: generates a new inner node for the station index, in its current version, its keys and children are set by the caller
  * Parameters:
- *   - currentStation: pointer to the currentStation of the tree
- *   - start: start station
- *   - end: end station
- * Returns: 1 if the route was found, 0 otherwise
+ *   - index: pointer to the station index
+ * Returns: pointer to the new inner node
  */
-int planRouteInOrder(pStation root, unsigned int start, unsigned int end);
+pInnerNode createInnerNode(pStationIndex index);
 /*
- * Function: planRouteReverseOrder
- * Description: plans a route from the start station to the end station if the stations are in reverse order
+ * Function: ownNode
+ * Description: makes a node modifiable in the current version, copying it if it belongs to an older one
  * Parameters:
- *   - root: pointer to the root of the tree
- *   - start: start station
- *   - end: end station
- * Returns: 1 if the route was found, 0 otherwise
+ *   - index: pointer to the station index
+ *   - link: pointer to the reference to the node in its parent (or to the root), it is updated with the copy
+ *   - isLeaf: 1 if the node is a leaf, 0 if it is an inner node
+ * Returns: pointer to the node that can be modified
  */
-int planRouteReverseOrder(pStation root, unsigned int start, unsigned int end);
+void* ownNode(pStationIndex index, void** link, int isLeaf);
 /*
- * Function: planRoute
- * Description: plans a route from the start station to the end station
+ * Function: writableLeaf
+ * Description: makes every node crossed to reach a leaf modifiable in the current version, from the root down
  * Parameters:
- *   - root: pointer to the root of the tree
- *   - start: start station
- *   - end: end station
- * Returns: 1 if the route was found, 0 otherwise
+ *   - index: pointer to the station index
+ *   - path: inner nodes crossed to reach the leaf, they are replaced with their copies
+ * Returns: pointer to the leaf that can be modified
  */
-void planRoute(pStation root, unsigned int start, unsigned int end);
-
-/* Global variables */
-unsigned int numberOfStations = 0; //number of stations in the tree
-
-
-int main() {
+pLeaf writableLeaf(pStationIndex index, TreePath* path);
+/*
+ * Function: writableStation
+ * Description: searches for a station in the index and makes it modifiable in the current version
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - stationID: ID of the station to search
+ * Returns: pointer to the station if found, NULL otherwise
+ */
+pStation writableStation(pStationIndex index, unsigned int stationID);
+/*
+ * Function: dropNode
+ * Description: releases a node removed from the tree, or retires it if an older version can still reach it
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - node: node removed from the tree
+ *   - isLeaf: 1 if the node is a leaf, 0 if it is an inner node
+ * Returns: void
+ */
+void dropNode(pStationIndex index, void* node, int isLeaf);
+/*
+ * Function: retireObject
+ * Description: adds an object that only older versions can reach to the ones released later by reclaimRetired
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - object: node or published version
+ *   - pool: pool the object comes from, NULL if it was allocated with malloc
+ * Returns: void
+ */
+void retireObject(pStationIndex index, void* object, Pool* pool);
+/*
+ * Function: publishIndex
+ * Description: publishes the current version of the station index for the readers and starts a new one
+ * Parameters:
+ *   - index: pointer to the station index
+ * Returns: void
+ */
+void publishIndex(pStationIndex index);
+/*
+ * Function: pinIndex
+ * Description: takes the last published version for a reader, its nodes are not released until unpinIndex
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - reader: slot of the reader, between 0 and MAX_READERS - 1
+ *   - view: pointer to the station index to fill with the root of the version, it can only be read
+ * Returns: void
+ */
+void pinIndex(pStationIndex index, int reader, StationIndex* view);
+/*
+ * Function: unpinIndex
+ * Description: releases the version held by a reader
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - reader: slot of the reader
+ * Returns: void
+ */
+void unpinIndex(pStationIndex index, int reader);
+/*
+ * Function: reclaimRetired
+ * Description: releases the retired objects that no reader holds and no reader can take anymore
+ * Parameters:
+ *   - index: pointer to the station index
+ * Returns: void
+ */
+void reclaimRetired(pStationIndex index);
+/*
+ * Function: findLeaf
+ * Description: descends the station index to the leaf where the given station is or should be
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - stationID: ID of the station
+ *   - path: pointer to store the inner nodes crossed, it can be NULL
+ * Returns: pointer to the leaf
+ */
+pLeaf findLeaf(pStationIndex index, unsigned int stationID, TreePath* path);
+/*
+ * Function: findChild
+ * Description: binary search of the child of an inner node where the given station is or should be
+ * Parameters:
+ *   - node: pointer to the inner node
+ *   - stationID: ID of the station
+ * Returns: position of the child, the position of the first key greater than stationID
+ */
+int findChild(pInnerNode node, unsigned int stationID);
+/*
+ * Function: refreshChild
+ * Description: recomputes the reach kept by an inner node for one of its children from the content of the child
+ * Parameters:
+ *   - node: pointer to the inner node
+ *   - position: position of the child
+ *   - isLeaf: 1 if the children of the node are leaves, 0 if they are inner nodes
+ * Returns: 1 if the reach of the child changed, 0 otherwise
+ */
+int refreshChild(pInnerNode node, int position, int isLeaf);
+/*
+ * Function: refreshReach
+ * Description: recomputes the reach kept for the children followed by a path, from the given level up to the root,
+ *              stopping at the first one that did not change
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - path: inner nodes crossed to reach a leaf whose stations changed, they belong to the current version
+ *   - level: deepest level to recompute
+ * Returns: void
+ */
+void refreshReach(pStationIndex index, TreePath* path, int level);
+/*
+ * Function: extendReach
+ * Description: widens the reach kept for the children followed by a path to cover a station whose reach grew,
+ *              stopping at the first one that already covered it, without reading the children
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - path: inner nodes crossed to reach the leaf of the station, they belong to the current version
+ *   - forwardReach: forwardReach of the station
+ *   - backwardReach: backwardReach of the station
+ * Returns: void
+ */
+void extendReach(pStationIndex index, TreePath* path, unsigned int forwardReach, int backwardReach);
+/*
+ * Function: shrinkReach
+ * Description: recomputes the reach kept for the children followed by a path after the reach of a station shrank or the
+ *              station was removed, only if no other station of its leaf reached as far
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - path: inner nodes crossed to reach the leaf of the station, they belong to the current version
+ *   - forwardReach: forwardReach of the station before it changed
+ *   - backwardReach: backwardReach of the station before it changed
+ * Returns: void
+ */
+void shrinkReach(pStationIndex index, TreePath* path, unsigned int forwardReach, int backwardReach);
+/*
+ * Function: inLastLeaf
+ * Description: checks whether every station of a range can only be in the leaf remembered by the range
+ * Parameters:
+ *   - range: pointer to the range
+ * Returns: 1 if the range fits in its remembered leaf, 0 otherwise
+ */
+int inLastLeaf(ReachRange* range);
+/*
+ * Function: reachInNodeInOrder
+ * Description: updates the largest forwardReach of a range with the stations under a node, visiting only the subtrees
+ *              partly inside the range. Computed over a whole level it takes O(log n)
+ * Parameters:
+ *   - node: inner node or leaf (when height is 0)
+ *   - height: number of levels of inner nodes under and including node
+ *   - lowBound: smallest stationID that can be under node
+ *   - highBound: largest stationID that can be under node
+ *   - range: pointer to the range, the last leaf visited is remembered
+ * Returns: void
+ */
+void reachInNodeInOrder(void* node, int height, unsigned int lowBound, unsigned int highBound, ReachRange* range);
+/*
+ * Function: reachInNodeReverseOrder
+ * Description: updates the smallest backwardReach of a range with the stations under a node as reachInNodeInOrder does
+ * Parameters:
+ *   - node: inner node or leaf (when height is 0)
+ *   - height: number of levels of inner nodes under and including node
+ *   - lowBound: smallest stationID that can be under node
+ *   - highBound: largest stationID that can be under node
+ *   - range: pointer to the range, the first leaf visited is remembered
+ * Returns: void
+ */
+void reachInNodeReverseOrder(void* node, int height, unsigned int lowBound, unsigned int highBound, ReachRange* range);
+/*
+ * Function: findReachingInOrder
+ * Description: searches the station of a range closest to the start of the highway whose forwardReach gets to the target,
+ *              skipping the subtrees whose reach does not get there
+ * Parameters:
+ *   - node: inner node or leaf (when height is 0)
+ *   - height: number of levels of inner nodes under and including node
+ *   - lowBound: smallest stationID that can be under node
+ *   - highBound: largest stationID that can be under node
+ *   - range: pointer to the range with the target, the leaf of the station is remembered
+ * Returns: pointer to the station, NULL if no station of the range under node reaches the target
+ */
+pStation findReachingInOrder(void* node, int height, unsigned int lowBound, unsigned int highBound, ReachRange* range);
+/*
+ * Function: findReachingReverseOrder
+ * Description: searches the station of a range closest to the start of the highway whose backwardReach gets to the target
+ *              as findReachingInOrder does
+ * Parameters:
+ *   - node: inner node or leaf (when height is 0)
+ *   - height: number of levels of inner nodes under and including node
+ *   - lowBound: smallest stationID that can be under node
+ *   - highBound: largest stationID that can be under node
+ *   - range: pointer to the range with the target, the leaf of the station is remembered
+ * Returns: pointer to the station, NULL if no station of the range under node reaches the target
+ */
+pStation findReachingReverseOrder(void* node, int height, unsigned int lowBound, unsigned int highBound, ReachRange* range);
+/*
+ * Function: findSlot
+ * Description: binary search of a station in a leaf
+ * Parameters:
+ *   - leaf: pointer to the leaf
+ *   - stationID: ID of the station
+ * Returns: position of the first station with an ID not smaller than stationID
+ */
+int findSlot(pLeaf leaf, unsigned int stationID);
+/*
+ * Function: splitLeaf
+ * Description: moves the upper half of a full leaf to a new leaf and adds the new leaf to the parent
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - leaf: leaf to split
+ *   - path: inner nodes crossed to reach the leaf
+ * Returns: pointer to the new leaf
+ */
+pLeaf splitLeaf(pStationIndex index, pLeaf leaf, TreePath* path);
+/*
+ * Function: insertChild
+ * Description: adds a new child and its separator to an inner node, splitting the nodes up to the root if they are full
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - path: inner nodes crossed to reach the child that was split
+ *   - level: level of the inner node that receives the new child
+ *   - key: smallest stationID in the new child
+ *   - child: new child, inserted right after the one that was split
+ * Returns: void
+ */
+void insertChild(pStationIndex index, TreePath* path, int level, unsigned int key, void* child);
+/*
+ * Function: removeChild
+ * Description: removes a child and the key before it from an inner node
+ * Parameters:
+ *   - node: pointer to the inner node
+ *   - position: position of the child to remove, never 0
+ * Returns: void
+ */
+void removeChild(pInnerNode node, int position);
+/*
+ * Function: rebalanceLeaf
+ * Description: refills a leaf that is less than half full by borrowing a station from a sibling or merging with it
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - leaf: leaf to refill
+ *   - path: inner nodes crossed to reach the leaf
+ * Returns: void
+ */
+void rebalanceLeaf(pStationIndex index, pLeaf leaf, TreePath* path);
+/*
+ * Function: rebalanceInner
+ * Description: refills an inner node that is less than half full by borrowing a child from a sibling or merging with it,
+ *              the root is removed when it is left with a single child
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - path: inner nodes crossed to reach the node
+ *   - level: level of the node to refill
+ * Returns: void
+ */
+void rebalanceInner(pStationIndex index, TreePath* path, int level);
+/*
+ * Function: addStation
+ * Description: inserts a new station in the index
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - stationID: ID of the new station
+ * Returns: pointer to the new station if it was added, NULL otherwise
+ */
+pStation addStation(pStationIndex index, unsigned int stationID);
+/*
+ * Function: removeStation
+ * Description: removes a station from the index
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - stationID: ID of the station to remove
+ * Returns: 1 if the station was removed, 0 otherwise
+ */
+int removeStation(pStationIndex index, unsigned int stationID);
+/*
+ * Function: searchStation
+ * Description: searches for a station in the index
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - stationID: ID of the station to search
+ * Returns: pointer to the station if found, NULL otherwise
+ */
+pStation searchStation(pStationIndex index, unsigned int stationID);
+/*
+ * Function: seekStation
+ * Description: positions a cursor on the first station with an ID not smaller than the given one
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - stationID: ID to seek
+ *   - cursor: pointer to the cursor to position
+ * Returns: pointer to the station under the cursor, NULL if every station has a smaller ID
+ */
+pStation seekStation(pStationIndex index, unsigned int stationID, StationCursor* cursor);
+/*
+ * Function: nextStation
+ * Description: moves a cursor to the next station towards the end of the highway
+ * Parameters:
+ *   - cursor: pointer to the cursor
+ * Returns: pointer to the station under the cursor, NULL if there are no more stations
+ */
+pStation nextStation(StationCursor* cursor);
+/*
+ * Function: freeStationIndex
+ * Description: removes every station from the index, returning the leaves, the inner nodes and the cars to their pools
+ * Parameters:
+ *   - index: pointer to the station index
+ * Returns: void
+ */
+void freeStationIndex(pStationIndex index);
+/*
+ * Function: initStationIndex
+ * Description: prepares an empty station index with empty pools
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - routes: pointer to the route cache whose answers are dropped when the stations change
+ * Returns: void
+ */
+void initStationIndex(pStationIndex index, RouteCache* routes);
+/*
+ * Function: freeIndexNode
+ * Description: returns a node of the station index and everything under it to the pools
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - node: inner node or leaf (when level is 0)
+ *   - level: number of levels of inner nodes under and including node
+ * Returns: void
+ */
+void freeIndexNode(pStationIndex index, void* node, int level);
+/*
+ * Function: buildInnerNodes
+ * Description: builds the inner nodes of the station index bottom up over its leaves, filling every node evenly
+ * Parameters:
+ *   - index: pointer to the station index, without inner nodes
+ *   - children: leaves sorted by stationID, the array is overwritten
+ *   - keys: smallest stationID of each leaf, the array is overwritten
+ *   - numberOfChildren: number of leaves, at least 1
+ * Returns: void
+ */
+void buildInnerNodes(pStationIndex index, void** children, unsigned int* keys, int numberOfChildren);
+/*
+ * Function: saveSnapshot
+ * Description: writes every station and its cars to a binary snapshot file. The file holds SNAPSHOT_MAGIC, the number
+ *              of stations and a 32 bit word left at 0, then for each station in order its ID, its number of cars and
+ *              the cars in heap order. Every number is a 32 bit word in the byte order of the machine.
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - path: path of the snapshot file
+ * Returns: 1 if the snapshot was written, 0 otherwise
+ */
+int saveSnapshot(pStationIndex index, const char* path);
+/*
+ * Function: loadSnapshot
+ * Description: fills an empty station index from a snapshot file mapped in memory, the leaves are built directly
+ *              in order and the cars are copied without rebuilding the heaps
+ * Parameters:
+ *   - index: pointer to the empty station index
+ *   - path: path of the snapshot file
+ * Returns: 1 if the snapshot was loaded, 0 if it could not be read or it is not valid
+ */
+int loadSnapshot(pStationIndex index, const char* path);
+/*
+ * Function: initRouteCache
+ * Description: marks every entry of the route cache as empty
+ * Parameters:
+ *   - cache: pointer to the route cache
+ * Returns: void
+ */
+void initRouteCache(RouteCache* cache);
+/*
+ * Function: clearRouteCache
+ * Description: drops every route in the route cache as if every station changed, the memory of the entries is kept for the next routes
+ * Parameters:
+ *   - cache: pointer to the route cache
+ * Returns: void
+ */
+void clearRouteCache(RouteCache* cache);
+/*
+ * Function: freeRouteCache
+ * Description: frees the memory of the routes stored in the route cache
+ * Parameters:
+ *   - cache: pointer to the route cache
+ * Returns: void
+ */
+void freeRouteCache(RouteCache* cache);
+/*
+ * Function: routeSlot
+ * Description: multiplicative hash of a query to the slot of the route cache that stores it
+ * Parameters:
+ *   - start: start station
+ *   - end: end station
+ * Returns: index of the slot
+ */
+unsigned int routeSlot(unsigned int start, unsigned int end);
+/*
+ * Function: lookupRoute
+ * Description: searches the route cache for the answer to a query
+ * Parameters:
+ *   - cache: pointer to the route cache
+ *   - start: start station
+ *   - end: end station
+ * Returns: pointer to the entry if the answer is cached, NULL otherwise
+ */
+RouteCacheEntry* lookupRoute(RouteCache* cache, unsigned int start, unsigned int end);
+/*
+ * Function: storeRoute
+ * Description: saves the answer to a query in the route cache, replacing the entry with the same slot
+ * Parameters:
+ *   - cache: pointer to the route cache
+ *   - start: start station
+ *   - end: end station
+ *   - route: stations of the route, empty if there is no route
+ * Returns: void
+ */
+void storeRoute(RouteCache* cache, unsigned int start, unsigned int end, pVector route);
+/*
+ * Function: invalidateRoutes
+ * Description: drops every cached route whose interval contains the given station
+ * Parameters:
+ *   - cache: pointer to the route cache
+ *   - stationID: station that was added, removed or changed its reach
+ * Returns: void
+ */
+void invalidateRoutes(RouteCache* cache, unsigned int stationID);
+/*
+ * Function: planRouteInOrder
+ * Description: plans a route from the start station to the end station if the stations are in order. The stations
+ *              reachable with one more step are found level by level from the largest forwardReach of the last level,
+ *              read from the station index in O(log n) for each level instead of walking every station of the level.
+ *              It is generated by DEFINE_ROUTE_ENGINE
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - start: start station
+ *   - end: end station
+ *   - workspace: pointer to the planner workspace, reset, where the stations of the route are stored in route
+ * Returns: 1 if the route was found, 0 otherwise
+ */
+int planRouteInOrder(pStationIndex index, unsigned int start, unsigned int end, PlannerWorkspace* workspace);
+/*
+ * Function: planRouteReverseOrder
+ * Description: plans a route from the start station to the end station if the stations are in reverse order,
+ *              level by level from the smallest backwardReach of the last level, generated by DEFINE_ROUTE_ENGINE
+ *              from the same body as planRouteInOrder
+ * Parameters:
+ *   - index: pointer to the station index
+ *   - start: start station
+ *   - end: end station
+ *   - workspace: pointer to the planner workspace, reset, where the stations of the route are stored in route
+ * Returns: 1 if the route was found, 0 otherwise
+ */
+int planRouteReverseOrder(pStationIndex index, unsigned int start, unsigned int end, PlannerWorkspace* workspace);
+/*
+ * Function: findRoute
+ * Description: plans a route from the start station to the end station, the answer is taken from the route cache when possible
+ * Parameters:
+ *   - highway: pointer to the highway
+ *   - start: start station, different from end
+ *   - end: end station
+ *   - numberOfStops: pointer to store the number of stations in the route, 0 if there is no route
+ * Returns: stations of the route, valid until the highway changes or another route is planned
+ */
+const unsigned int* findRoute(Highway* highway, unsigned int start, unsigned int end, int* numberOfStops);
+#ifdef HIGHWAY_JUMP_INDEX
+/*
+ * Function: initJumpIndex
+ * Description: initializes a stale jump index with no arrays
+ * Parameters:
+ *   - jumps: pointer to the jump index
+ * Returns: void
+ */
+void initJumpIndex(JumpIndex* jumps);
+/*
+ * Function: freeJumpIndex
+ * Description: frees the arrays of a jump index
+ * Parameters:
+ *   - jumps: pointer to the jump index
+ * Returns: void
+ */
+void freeJumpIndex(JumpIndex* jumps);
+/*
+ * Function: buildJumpIndex
+ * Description: rebuilds the jump index of a highway from its stations in O(n log n), the arrays grow if they are too small
+ * Parameters:
+ *   - highway: pointer to the highway
+ * Returns: void
+ */
+void buildJumpIndex(Highway* highway);
+/*
+ * Function: chargeJumpIndex
+ * Description: adds the reaches read by the planners on a query a stale jump index would have answered to its work, and
+ *              rebuilds it once the work since the last change of the stations costs as much as rebuilding it
+ * Parameters:
+ *   - highway: pointer to the highway
+ *   - reaches: reaches read by the planners on the query
+ * Returns: void
+ */
+void chargeJumpIndex(Highway* highway, unsigned long reaches);
+/*
+ * Function: buildJumpChain
+ * Description: computes parent, jump and depth of every position of a chain from its reach, walking the positions backwards
+ * Parameters:
+ *   - chain: pointer to the chain, with reach filled
+ *   - stack: array of numberOfStations ints to use as a stack
+ *   - numberOfStations: number of positions
+ * Returns: void
+ */
+void buildJumpChain(JumpChain* chain, int* stack, int numberOfStations);
+/*
+ * Function: countStationsUpTo
+ * Description: binary search of the number of stations of the jump index with an ID not greater than stationID
+ * Parameters:
+ *   - jumps: pointer to the jump index
+ *   - stationID: largest ID counted
+ * Returns: number of stations up to stationID, the position of the next station
+ */
+int countStationsUpTo(JumpIndex* jumps, unsigned int stationID);
+/*
+ * Function: countJumps
+ * Description: counts the stations of the route with the fewest stops in O(log n), the jump index must be up to date
+ * Parameters:
+ *   - jumps: pointer to the jump index
+ *   - start: start station, different from end
+ *   - end: end station
+ * Returns: number of stations in the route, 0 if there is no route
+ */
+int countJumps(JumpIndex* jumps, unsigned int start, unsigned int end);
+#endif
+#ifndef HIGHWAY_LIBRARY
+/*
+ * Function: reportPoolOccupancy
+ * Description: writes on stderr how many objects of each pool of the highway of the program are in use
+ * Parameters: void
+ * Returns: void
+ */
+void reportPoolOccupancy();
+/*
+ * Function: reportRouteCache
+ * Description: writes on stderr the hits and misses of the route cache of the highway of the program
+ * Parameters: void
+ * Returns: void
+ */
+void reportRouteCache();
+/*
+ * Function: writeRoute
+ * Description: writes the stations of a route separated by spaces, or "nessun percorso" if there is no route
+ * Parameters:
+ *   - stops: stations of the route
+ *   - numberOfStops: number of stations in the route, 0 if there is no route
+ * Returns: void
+ */
+void writeRoute(const unsigned int* stops, int numberOfStops);
+/*
+ * Function: planRoute
+ * Description: plans a route from the start station to the end station and writes it
+ * Parameters:
+ *   - highway: pointer to the highway
+ *   - start: start station
+ *   - end: end station
+ * Returns: void
+ */
+void planRoute(Highway* highway, unsigned int start, unsigned int end);
+/*
+ * Function: runCommands
+ * Description: performs the commands read from input until it is over, timing them, batching the route queries
+ *              or one at a time depending on how the program was built and started
+ * Parameters:
+ *   - highway: pointer to the highway
+ * Returns: void
+ */
+void runCommands(Highway* highway);
+/*
+ * Function: executeCommand
+ * Description: reads the arguments of a command from input, performs it and writes the reply
+ * Parameters:
+ *   - highway: pointer to the highway
+ *   - action: command to perform
+ * Returns: void
+ */
+void executeCommand(Highway* highway, Action action);
+/*
+ * Function: readCars
+ * Description: reads the number of cars and the cars of an aggiungi-stazione command
+ * Parameters:
+ *   - cars: pointer to the vector to store the cars, it is emptied first
+ * Returns: void
+ */
+void readCars(pVector cars);
+/*
+ * Function: bulkLoadStations
+ * Description: adds a run of aggiungi-stazione commands with increasing IDs to the empty station index, filling
+ *              the leaves in order and building the inner nodes once at the end of the run. The run stops at the first
+ *              other command, whose arguments are left in input, or at the first station not larger than the previous
+ *              one, which is added to the built index as usual.
+ * Parameters:
+ *   - highway: pointer to the highway with no stations, the ADDSTATION action was read but not its arguments
+ * Returns: the next action to perform, its arguments are not read yet
+ */
+Action bulkLoadStations(Highway* highway);
+#ifdef HIGHWAY_PARALLEL
+/*
+ * Function: initPlannerPool
+ * Description: prepares the query batches and starts the pool of threads, HIGHWAY_THREADS sets the number of threads
+ *              (the main one included), by default there is one for each processor
+ * Parameters:
+ *   - pool: pointer to the planner pool
+ *   - highway: pointer to the highway the routes are planned on
+ * Returns: number of threads started besides the main one
+ */
+int initPlannerPool(PlannerPool* pool, Highway* highway);
+/*
+ * Function: addQuery
+ * Description: adds a route query to the collecting batch, handing the batch to the pool first if it is full
+ * Parameters:
+ *   - pool: pointer to the planner pool
+ *   - start: start station, different from end
+ *   - end: end station
+ * Returns: void
+ */
+void addQuery(PlannerPool* pool, unsigned int start, unsigned int end);
+/*
+ * Function: dispatchQueries
+ * Description: answers the batch being planned, then looks up the collecting batch in the route cache, publishes
+ *              the current version of the station index and hands the batch to the pool without waiting for it.
+ *              The replies written from now on are held until the answers of the batch are written.
+ * Parameters:
+ *   - pool: pointer to the planner pool
+ * Returns: void
+ */
+void dispatchQueries(PlannerPool* pool);
+/*
+ * Function: completeQueries
+ * Description: waits for the pool to plan its batch, writes the answers in order followed by the replies held
+ *              in the meantime and saves the new routes in the route cache
+ * Parameters:
+ *   - pool: pointer to the planner pool
+ * Returns: void
+ */
+void completeQueries(PlannerPool* pool);
+/*
+ * Function: finishQueries
+ * Description: answers every query read so far
+ * Parameters:
+ *   - pool: pointer to the planner pool
+ * Returns: void
+ */
+void finishQueries(PlannerPool* pool);
+/*
+ * Function: finishQueriesAtExit
+ * Description: answers the queries of the planner pool and writes the replies held meanwhile when the thread
+ *              performing the commands stops the program with an exit code
+ * Parameters: void
+ * Returns: void
+ */
+void finishQueriesAtExit();
+/*
+ * Function: planQueries
+ * Description: takes the queries of the batch one at a time, until none is left, and plans the ones that are not cached
+ *              on the last published version of the station index
+ * Parameters:
+ *   - pool: pointer to the planner pool
+ *   - workspace: pointer to the planner workspace of the calling thread
+ *   - reader: reader slot of the calling thread
+ * Returns: void
+ */
+void planQueries(PlannerPool* pool, PlannerWorkspace* workspace, int reader);
+/*
+ * Function: runWorker
+ * Description: body of the threads of the pool, each one plans its share of every batch with its own workspace
+ * Parameters:
+ *   - argument: pointer to the planner pool
+ * Returns: NULL, it never returns
+ */
+void* runWorker(void* argument);
+#endif
+#ifdef HIGHWAY_STATS
+/*
+ * Function: recordLatency
+ * Description: adds the time since the previous command was timed to the latency histogram of action. It is called at the
+ *              end of every command of the main loop, so a command is charged for reading it, and a route query batched
+ *              by the planner pool only for queueing it, its planning is charged to the command that dispatches the batch
+ * Parameters:
+ *   - action: command that just ended
+ * Returns: void
+ */
+void recordLatency(Action action);
+/*
+ * Function: reportStatistics
+ * Description: writes the counters and the latency histograms in the statistics file, one "name value" pair per line
+ * Parameters: void
+ * Returns: void
+ */
+void reportStatistics();
+#endif
+#ifdef HIGHWAY_BENCHMARK
+/*
+ * Function: benchmarkWorkload
+ * Description: runs every command of a workload file on an empty highway, recording how long each one takes
+ * Parameters:
+ *   - path: path of the workload file
+ *   - highway: pointer to the highway, it is emptied at the end
+ *   - latencies: nanoseconds spent on each command, one vector per action
+ * Returns: nanoseconds spent on the whole workload
+ */
+unsigned long long benchmarkWorkload(const char* path, Highway* highway, pVector latencies[]);
+/*
+ * Function: reportBenchmark
+ * Description: writes on stdout, as JSON, the number of commands, the throughput and the p50 and p99 latency of each action
+ * Parameters:
+ *   - latencies: nanoseconds spent on each command, one vector per action, they are sorted
+ * Returns: void
+ */
+void reportBenchmark(pVector latencies[]);
+/*
+ * Function: compareUnsigned
+ * Description: compares two unsigned int for qsort
+ * Parameters:
+ *   - first: pointer to the first number
+ *   - second: pointer to the second number
+ * Returns: negative, zero or positive if the first number is smaller, equal or greater than the second one
+ */
+int compareUnsigned(const void* first, const void* second);
+/*
+ * Function: benchmarkCarScan
+ * Description: writes on stdout, as JSON, the nanoseconds per search of a car with each scan kernel and with findCar
+ *              for fleets from 1 to 512 cars, three searches in four find a car
+ * Parameters: void
+ * Returns: void
+ */
+void benchmarkCarScan();
+#endif
+#endif
+
+/* Global variables */
+#ifdef HIGHWAY_STATS
+Statistics statistics; //work done by the hot paths
+#endif
+#ifndef HIGHWAY_LIBRARY
+Highway* commandHighway; //highway the commands read from input are performed on
+pVector commandCars; //cars of the aggiungi-stazione command being performed
+InputBuffer input; //input stream the commands are read from
+OutputBuffer output; //output stream the replies are written to
+#ifdef HIGHWAY_PARALLEL
+PlannerPool plannerPool; //threads planning the route queries
+#endif
+#ifdef HIGHWAY_PIPELINE
+CommandPipeline pipeline; //parser thread and ring of the commands it decoded
+#endif
+
+
+#ifdef HIGHWAY_BENCHMARK
+int main(int argc, char* argv[]) {
+    pVector latencies[ENDINPUT]; //time spent on each command, one vector per action
+    unsigned long long workloadTime; //time spent on the current workload
+    unsigned int repetitions = 1; //number of times each workload is run
+    unsigned int round;
+    int action;
+    int i;
+
+    if(argc > 1 && strcmp(argv[1], "--cars") == 0) {// Microbenchmark of the search of a car instead of the workloads
+        benchmarkCarScan();
+        return 0;
+    }
+    if(getenv("HIGHWAY_BENCHMARK_REPEAT") != NULL && atoi(getenv("HIGHWAY_BENCHMARK_REPEAT")) > 0)
+        repetitions = (unsigned int) atoi(getenv("HIGHWAY_BENCHMARK_REPEAT"));
+    output.fd = open("/dev/null", O_WRONLY); //the replies are produced as usual and thrown away
+    commandHighway = createHighway();
+    if(commandHighway == NULL) {
+        exit(15);
+    }
+    commandCars = newVector(PLANNER_INITIAL_SIZE);
+    for(action = 0; action < ENDINPUT; action++)
+        latencies[action] = newVector(1024);
+
+    printf("{\n  \"repetitions\": %u,\n  \"workloads\": [", repetitions);
+    for(i = 1; i < argc; i++) {
+        workloadTime = 0;
+        for(round = 0; round < repetitions; round++)
+            workloadTime += benchmarkWorkload(argv[i], commandHighway, latencies);
+        printf("%s\n    {\"file\": \"%s\", \"ns\": %llu}", i > 1 ? "," : "", argv[i], workloadTime / repetitions);
+    }
+    printf("\n  ],\n");
+    reportBenchmark(latencies);
+    printf("}\n");
+
+    for(action = 0; action < ENDINPUT; action++)
+        freeVector(latencies[action]);
+    return 0;
+}
+#else
+int main() {
+    initInput(STDIN_FILENO);
+    output.fd = STDOUT_FILENO;
+    atexit(flushOutput); //the replies are written even when the program stops with an exit code
+    commandHighway = createHighway();
+    if(commandHighway == NULL) {
+        exit(15);
+    }
+    commandCars = newVector(PLANNER_INITIAL_SIZE);
+    if(getenv("HIGHWAY_POOL_STATS") != NULL)
+        atexit(reportPoolOccupancy);
+    if(getenv("HIGHWAY_CACHE_STATS") != NULL)
+        atexit(reportRouteCache);
+    if(getenv("HIGHWAY_LOAD_SNAPSHOT") != NULL && highwayLoadSnapshot(commandHighway, getenv("HIGHWAY_LOAD_SNAPSHOT")) == 0) {
+        fprintf(stderr, "cannot load the snapshot %s\n", getenv("HIGHWAY_LOAD_SNAPSHOT"));
+        exit(13);
+    }
+#ifdef HIGHWAY_PIPELINE
+    if(startPipeline(&pipeline)) {
+        runCommands(commandHighway);
+        stopPipeline(&pipeline);
+    } else {
+        runCommands(commandHighway);
+    }
+#else
+    runCommands(commandHighway);
+#endif
+    if(getenv("HIGHWAY_SAVE_SNAPSHOT") != NULL && highwaySaveSnapshot(commandHighway, getenv("HIGHWAY_SAVE_SNAPSHOT")) == 0) {
+        fprintf(stderr, "cannot save the snapshot %s\n", getenv("HIGHWAY_SAVE_SNAPSHOT"));
+        exit(14);
+    }
+    return 0;
+}
+#endif
+
+void runCommands(Highway* highway) {
     Action action; //action to perform
+#ifdef HIGHWAY_PARALLEL
+    unsigned int start; //start station of a route query
+    unsigned int end; //end station of a route query
+#endif
+
+#ifdef HIGHWAY_STATS
+    statistics.path = getenv("HIGHWAY_STATS_FILE");
+    if(statistics.path != NULL) {// The commands are timed in the loops below, on the same path as without statistics
+        statistics.enabled = 1;
+        atexit(reportStatistics);
+        clock_gettime(CLOCK_MONOTONIC, &statistics.commandEnd);
+    }
+#endif
+#ifdef HIGHWAY_PARALLEL
+    if(initPlannerPool(&plannerPool, highway) > 0) {
+        atexit(finishQueriesAtExit); //run before flushOutput, registered earlier
+        action = readAction();
+        while (action != ENDINPUT) {
+            if(action == PLANROUTE) {
+                readInt(&start);
+                readInt(&end);
+                if(start != end) {
+                    addQuery(&plannerPool, start, end);
+                } else {
+                    finishQueries(&plannerPool); //the replies before a failing query are written before the program stops
+                    planRoute(highway, start, end);
+                }
+                TIME_COMMAND(PLANROUTE);
+                action = readAction();
+                continue;
+            }
+            dispatchQueries(&plannerPool); //the queries are planned on the stations as they are before this command
+            if(action == ADDSTATION && highway->index.root == NULL) {
+                action = bulkLoadStations(highway);
+                continue;
+            }
+            executeCommand(highway, action);
+            TIME_COMMAND(action);
+            action = readAction();
+        }
+        finishQueries(&plannerPool);
+        return;
+    }
+#endif
+    while ((action = readAction()) != ENDINPUT) {
+        if(action == ADDSTATION && highway->index.root == NULL) {// The stations of an empty highway are often given in order
+            action = bulkLoadStations(highway);
+            if(action == ENDINPUT)
+                break;
+        }
+        executeCommand(highway, action);
+        TIME_COMMAND(action);
+    }
+}
+
+void executeCommand(Highway* highway, Action action) {
     unsigned int carID; //number read from input
     unsigned int stationID; //number read from input
-    Station *station; //pointer to a station
-    pStation root = NULL; //root of the red-black tree
 
-    while ((action = readAction()) != ENDINPUT) {
-        switch (action) {
-            case ADDSTATION: //the input said to add a station
-                readInt(&stationID); //read the station id
-                station = addStation(&root, stationID); //insertLinked the station in the tree
-                if(station == NULL){ //if the station was already in the tree
-                    while (readInt(&carID) != 0); //WARNING: this is a workaround I'm not sure if I should add the cars or not
-                    printf("non aggiunta\n");
-                }
-                else{ //if the station was not in the tree
-                    if(readInt(&carID) != 0) {
-                        while (readInt(&carID) != 0) { //read the cars in the station until the last one is read
-                            addCar(station->cars, carID); //insertLinked the car in the station
-                        }
-                        //if(carID != 0)
-                            addCar(station->cars, carID);//insertLinked the last car in the station
-                    }
-                    printf("aggiunta\n");
-                }
-                break;
+    switch (action) {
+        case ADDSTATION: //the input said to add a station
+            readInt(&stationID); //read the station id
+            readCars(commandCars); //read the cars of the station
+            if(highwayAddStation(highway, stationID, commandCars->array, commandCars->numberOfElements) == 0){ //if the station was already in the tree
+                writeText("non aggiunta\n");
+            }
+            else{ //if the station was not in the tree
+                writeText("aggiunta\n");
+            }
+            break;
+
+        case RMVSTATION:
+            readInt(&stationID);    //read the station id
+            if(highwayRemoveStation(highway, stationID) == 0){ //if the station is not in the tree
+                writeText("non demolita\n");
+            }
+            else{ //if the station was removed
+                writeText("demolita\n");
+            }
+            break;
+        case ADDCAR:
+            readInt(&stationID); //read the station id
+            readInt(&carID); //read the car id
+            if(highwayAddCar(highway, stationID, carID) == 0) { //if the station is not in the tree
+                writeText("non aggiunta\n");
+            } else {
+                writeText("aggiunta\n");
+            }
+            break;
+        case RMVCAR:
+            readInt(&stationID); //read the station id
+            readInt(&carID); //read the car id
+            if(highwayRemoveCar(highway, stationID, carID)) { //the car was in the station
+                writeText("rottamata\n");
+            } else { //the station or the car was not found
+                writeText("non rottamata\n");
+            }
+            break;
+        case PLANROUTE:
+            readInt(&stationID); //read the station id
+            readInt(&carID); //reads the second station id
+            planRoute(highway, stationID, carID); //plans the route
+            break;
+        default:
+            writeText("invalid action\n");
+            exit(5);
+    }
+}
+
+void readCars(pVector cars) {
+    unsigned int carID; //number read from input
+
+    cars->numberOfElements = 0;
+    if(readInt(&carID) != 0) { //the number of cars is not the last number of the line
+        while (readInt(&carID) != 0) { //read the cars in the station until the last one is read
+            addVector(cars, carID);
+        }
+        addVector(cars, carID); //the last car of the station
+    }
+}
+
+Action bulkLoadStations(Highway* highway) {
+    pStationIndex index = &highway->index;
+    int leavesCapacity = 64; //leaves that fit in the arrays
+    int numberOfLeaves = 0;
+    void** leaves = (void**) malloc(leavesCapacity * sizeof(void*));
+    unsigned int* keys = (unsigned int*) malloc(leavesCapacity * sizeof(unsigned int));
+    pLeaf leaf = NULL;
+    pLeaf previous;
+    pStation station;
+    unsigned int stationID;
+    unsigned int nextID = 0;
+    Action action;
+    int moved;
+    int i;
+
+    if(leaves == NULL || keys == NULL)
+        exit(7);
+    readInt(&stationID);
+    for(;;) {
+        if(leaf == NULL || leaf->numberOfStations == LEAF_SIZE) {// The leaves are filled in order, as for a snapshot
+            if(numberOfLeaves == leavesCapacity) {
+                leavesCapacity *= 2;
+                leaves = (void**) realloc(leaves, leavesCapacity * sizeof(void*));
+                keys = (unsigned int*) realloc(keys, leavesCapacity * sizeof(unsigned int));
+                if(leaves == NULL || keys == NULL)
+                    exit(7);
+            }
+            leaf = createLeaf(index);
+            keys[numberOfLeaves] = stationID;
+            leaves[numberOfLeaves++] = leaf;
+        }
+        station = &leaf->stations[leaf->numberOfStations++];
+        station->stationID = stationID;
+        station->forwardReach = stationID;
+        station->backwardReach = (int) stationID;
+        station->cars = createMaxHeap(index);
+        index->numberOfStations++;
+        invalidateRoutes(index->routes, stationID);
+        readCars(commandCars);
+        for(i = 0; i < commandCars->numberOfElements; i++)
+            addCar(index, station, commandCars->array[i]);
+        writeText("aggiunta\n");
+        TIME_COMMAND(ADDSTATION);
+
+        action = readAction();
+        if(action != ADDSTATION)
+            break;
+        readInt(&nextID);
+        if(nextID <= stationID)
+            break;
+        stationID = nextID;
+    }
+
+    // The last leaf takes stations from the previous one until both are at least half full
+    if(numberOfLeaves > 1 && leaf->numberOfStations < LEAF_SIZE / 2) {
+        previous = (pLeaf) leaves[numberOfLeaves - 2];
+        moved = (previous->numberOfStations + leaf->numberOfStations) / 2 - leaf->numberOfStations;
+        memmove(&leaf->stations[moved], leaf->stations, leaf->numberOfStations * sizeof(Station));
+        memcpy(leaf->stations, &previous->stations[previous->numberOfStations - moved], moved * sizeof(Station));
+        previous->numberOfStations -= moved;
+        leaf->numberOfStations += moved;
+        keys[numberOfLeaves - 1] = leaf->stations[0].stationID;
+    }
+    buildInnerNodes(index, leaves, keys, numberOfLeaves);
+    free(leaves);
+    free(keys);
+
+    if(action != ADDSTATION)
+        return action;
+    // The station out of order is added to the index just built
+    readCars(commandCars);
+    if(highwayAddStation(highway, nextID, commandCars->array, commandCars->numberOfElements) == 0)
+        writeText("non aggiunta\n");
+    else
+        writeText("aggiunta\n");
+    TIME_COMMAND(ADDSTATION);
+    return readAction();
+}
+
+#ifdef HIGHWAY_PARALLEL
+int initPlannerPool(PlannerPool* pool, Highway* highway) {
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int i, j;
+
+    if(getenv("HIGHWAY_THREADS") != NULL)
+        threads = atol(getenv("HIGHWAY_THREADS"));
+    if(threads > MAX_WORKERS + 1)
+        threads = MAX_WORKERS + 1;
+
+    pool->highway = highway;
+    pool->owner = pthread_self();
+    pool->batch = NULL;
+    pool->collecting = 0;
+    pool->nextQuery = 0;
+    pool->numberOfWorkers = 0;
+    pool->startedWorkers = 0;
+    pool->busyWorkers = 0;
+    pool->round = 0;
+    for(i = 0; i < 2; i++) {
+        pool->batches[i].numberOfQueries = 0;
+        for(j = 0; j < QUERY_BATCH_SIZE; j++)
+            pool->batches[i].queries[j].route = NULL; //allocated the first time the query is used
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->started, NULL);
+    pthread_cond_init(&pool->finished, NULL);
+    for(i = 0; i < threads - 1; i++) {
+        if(pthread_create(&pool->workers[i], NULL, runWorker, pool) != 0)
+            break; //the threads already started are enough
+        pool->numberOfWorkers++;
+    }
+    return pool->numberOfWorkers;
+}
+
+void addQuery(PlannerPool* pool, unsigned int start, unsigned int end) {
+    QueryBatch* batch = &pool->batches[pool->collecting];
+    RouteQuery* query;
+
+    if(batch->numberOfQueries == QUERY_BATCH_SIZE) {
+        dispatchQueries(pool);
+        batch = &pool->batches[pool->collecting];
+    }
+    query = &batch->queries[batch->numberOfQueries++];
+    query->start = start;
+    query->end = end;
+    if(query->route == NULL)
+        query->route = newVector(PLANNER_INITIAL_SIZE);
+}
+
+void dispatchQueries(PlannerPool* pool) {
+    QueryBatch* batch = &pool->batches[pool->collecting];
+    RouteCacheEntry* entry;
+    RouteQuery* query;
+    int i, j;
+
+    if(batch->numberOfQueries == 0)
+        return;
+    completeQueries(pool);
+
+    // The cached answers are copied now, the next commands may drop them from the cache
+    for(i = 0; i < batch->numberOfQueries; i++) {
+        query = &batch->queries[i];
+        entry = lookupRoute(&pool->highway->routes, query->start, query->end);
+        query->cached = entry != NULL;
+        query->route->numberOfElements = 0;
+        for(j = 0; query->cached && j < entry->numberOfStops; j++)
+            addVector(query->route, entry->stops[j]);
+    }
+    batch->changes = pool->highway->routes.changes;
+
+    publishIndex(&pool->highway->index);
+    pool->batch = batch;
+    pool->collecting = !pool->collecting;
+    pool->nextQuery = 0;
+    holdOutput();
+
+    pthread_mutex_lock(&pool->lock);
+    pool->busyWorkers = pool->numberOfWorkers;
+    pool->round++;
+    pthread_cond_broadcast(&pool->started);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void completeQueries(PlannerPool* pool) {
+    QueryBatch* batch = pool->batch;
+    int i;
+
+    if(batch == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    while(pool->busyWorkers > 0)
+        pthread_cond_wait(&pool->finished, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+
+    // The replies of the commands read after the batch go after its answers
+    flushOutput();
+    output.held = 0;
+    for(i = 0; i < batch->numberOfQueries; i++) {
+        writeRoute(batch->queries[i].route->array, batch->queries[i].route->numberOfElements);
+        if(!batch->queries[i].cached) {// The workers do not touch the statistics, they are shared by the whole program
+            COUNT(routesPlanned, 1);
+            COUNT(reachesRead, batch->queries[i].visited);
+        }
+    }
+    writeHeldOutput();
+
+    // The routes were planned on the stations as they were when the batch was handed to the pool
+    if(batch->changes == pool->highway->routes.changes) {
+        for(i = 0; i < batch->numberOfQueries; i++) {
+            if(!batch->queries[i].cached)
+                storeRoute(&pool->highway->routes, batch->queries[i].start, batch->queries[i].end, batch->queries[i].route);
+        }
+    }
+    batch->numberOfQueries = 0;
+    pool->batch = NULL;
+    reclaimRetired(&pool->highway->index);
+}
+
+void finishQueries(PlannerPool* pool) {
+    dispatchQueries(pool);
+    completeQueries(pool);
+}
+
+void finishQueriesAtExit() {
+    if(pthread_equal(pthread_self(), plannerPool.owner)) //a worker stopping the program would wait for itself
+        finishQueries(&plannerPool);
+}
+
+void planQueries(PlannerPool* pool, PlannerWorkspace* workspace, int reader) {
+    QueryBatch* batch = pool->batch;
+    pVector route = workspace->route;
+    StationIndex view;
+    RouteQuery* query;
+    int i;
+
+    pinIndex(&pool->highway->index, reader, &view);
+    while((i = __atomic_fetch_add(&pool->nextQuery, 1, __ATOMIC_RELAXED)) < batch->numberOfQueries) {
+        query = &batch->queries[i];
+        if(query->cached)
+            continue;
+        workspace->route = query->route; //the route is planned directly in the vector of the query
+        resetPlannerWorkspace(workspace);
+        if(query->start > query->end)
+            planRouteReverseOrder(&view, query->start, query->end, workspace);
+        else
+            planRouteInOrder(&view, query->start, query->end, workspace);
+        query->visited = workspace->visited;
+    }
+    unpinIndex(&pool->highway->index, reader);
+    workspace->route = route;
+}
+
+void* runWorker(void* argument) {
+    PlannerPool* pool = (PlannerPool*) argument;
+    PlannerWorkspace workspace;
+    unsigned long round = 0;
+    int reader = __atomic_fetch_add(&pool->startedWorkers, 1, __ATOMIC_RELAXED);
+
+    initPlannerWorkspace(&workspace);
+    for(;;) {
+        pthread_mutex_lock(&pool->lock);
+        while(pool->round == round)
+            pthread_cond_wait(&pool->started, &pool->lock);
+        round = pool->round;
+        pthread_mutex_unlock(&pool->lock);
+
+        planQueries(pool, &workspace, reader);
+
+        pthread_mutex_lock(&pool->lock);
+        if(--pool->busyWorkers == 0)
+            pthread_cond_signal(&pool->finished);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+#endif
+
+#ifdef HIGHWAY_STATS
+void recordLatency(Action action) {
+    struct timespec now;
+    unsigned long long elapsed;
+    int bucket;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = (unsigned long long) (now.tv_sec - statistics.commandEnd.tv_sec) * 1000000000ULL + now.tv_nsec - statistics.commandEnd.tv_nsec;
+    statistics.commandEnd = now;
+    bucket = elapsed == 0 ? 0 : 64 - __builtin_clzll(elapsed);
+    statistics.latency[action][bucket < STATS_BUCKETS ? bucket : STATS_BUCKETS - 1]++;
+}
+
+void reportStatistics() {
+    const char* names[ENDINPUT] = {"ADDSTATION", "RMVSTATION", "ADDCAR", "RMVCAR", "PLANROUTE"};
+    FILE* file = fopen(statistics.path, "w");
+    int action;
+    int bucket;
+
+    if(file == NULL) {
+        fprintf(stderr, "cannot write the statistics to %s\n", statistics.path);
+        return;
+    }
+    fprintf(file, "leafSplits %lu\ninnerSplits %lu\nrootSplits %lu\n",
+            statistics.leafSplits, statistics.innerSplits, statistics.rootSplits);
+    fprintf(file, "leafBorrows %lu\ninnerBorrows %lu\nleafMerges %lu\ninnerMerges %lu\nrootCollapses %lu\n",
+            statistics.leafBorrows, statistics.innerBorrows, statistics.leafMerges, statistics.innerMerges, statistics.rootCollapses);
+    fprintf(file, "siftUpSteps %lu\nsiftDownSteps %lu\ncarScans %lu\ncarScanLength %lu\n",
+            statistics.siftUpSteps, statistics.siftDownSteps, statistics.carScans, statistics.carScanLength);
+    fprintf(file, "routesPlanned %lu\nreachesRead %lu\n", statistics.routesPlanned, statistics.reachesRead);
+    for(action = 0; action < ENDINPUT; action++) {
+        for(bucket = 0; bucket < STATS_BUCKETS; bucket++) {
+            if(statistics.latency[action][bucket] > 0) //only the buckets in use, "latency ACTION limit count" with limit in nanoseconds
+                fprintf(file, "latency %s %llu %lu\n", names[action], 1ULL << bucket, statistics.latency[action][bucket]);
+        }
+    }
+    fclose(file);
+}
+#endif
+
+#ifdef HIGHWAY_BENCHMARK
+unsigned long long benchmarkWorkload(const char* path, Highway* highway, pVector latencies[]) {
+    struct timespec before;
+    struct timespec after;
+    unsigned long long total = 0;
+    unsigned long long elapsed;
+    Action action;
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0) {
+        fprintf(stderr, "cannot open %s\n", path);
+        exit(12);
+    }
+    initInput(fd);
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    for(;;) {
+        action = readAction(); //the time spent reading the name of the command is charged to the command
+        if(action == ENDINPUT)
+            break;
+        executeCommand(highway, action);
+        clock_gettime(CLOCK_MONOTONIC, &after);
+        elapsed = (unsigned long long) (after.tv_sec - before.tv_sec) * 1000000000ULL + after.tv_nsec - before.tv_nsec;
+        addVector(latencies[action], elapsed > UINT_MAX ? UINT_MAX : (unsigned int) elapsed);
+        total += elapsed;
+        before = after;
+    }
+    flushOutput();
+    releaseInput();
+    close(fd);
+    freeStationIndex(&highway->index); //every workload starts from an empty highway
+    clearRouteCache(&highway->routes);
+    return total;
+}
+
+void reportBenchmark(pVector latencies[]) {
+    const char* names[ENDINPUT] = {"ADDSTATION", "RMVSTATION", "ADDCAR", "RMVCAR", "PLANROUTE"};
+    unsigned long long total;
+    int count;
+    int action;
+    int i;
+
+    printf("  \"actions\": {");
+    for(action = 0; action < ENDINPUT; action++) {
+        count = latencies[action]->numberOfElements;
+        total = 0;
+        for(i = 0; i < count; i++)
+            total += latencies[action]->array[i];
+        qsort(latencies[action]->array, count, sizeof(unsigned int), compareUnsigned);
+        printf("%s\n    \"%s\": {\"count\": %d, \"total_ns\": %llu, \"per_second\": %.0f, \"p50_ns\": %u, \"p99_ns\": %u}",
+               action > 0 ? "," : "", names[action], count, total, total > 0 ? count * 1e9 / total : 0.0,
+               count > 0 ? latencies[action]->array[(count - 1) * 50 / 100] : 0,
+               count > 0 ? latencies[action]->array[(count - 1) * 99 / 100] : 0);
+    }
+    printf("\n  }\n");
+}
+
+int compareUnsigned(const void* first, const void* second) {
+    unsigned int a = *(const unsigned int*) first;
+    unsigned int b = *(const unsigned int*) second;
+
+    return (a > b) - (a < b);
+}
+
+void benchmarkCarScan() {
+    const int fleets[] = {1, 2, 4, 6, 8, 12, 16, 24, 32, 48, 64, 128, 256, 512};
+    const char* names[] = {"scalar", "sse2", "avx2", "findCar"};
+    unsigned int cars[512];
+    unsigned int searched[1024]; //ranges searched, each kernel searches all of them the same number of times
+    unsigned long long random = 1;
+    unsigned long long elapsed;
+    long found = 0; //printed so that the searches cannot be left out by the compiler
+    struct timespec before;
+    struct timespec after;
+    Highway* highway = createHighway();
+    pMaxHeap heap;
+    int kernel;
+    int round;
+    int rounds;
+    int f;
+    int i;
+
+    if(highway == NULL)
+        exit(15);
+    printf("{\n  \"car_scan\": [");
+    for(f = 0; f < (int) (sizeof(fleets) / sizeof(fleets[0])); f++) {
+        for(i = 0; i < fleets[f]; i++) {
+            random = random * 6364136223846793005ULL + 1442695040888963407ULL;
+            cars[i] = (unsigned int) (random >> 40) % 100000;
+        }
+        for(i = 0; i < 1024; i++) {// Ranges of the fleet, or one range in four that no car has
+            random = random * 6364136223846793005ULL + 1442695040888963407ULL;
+            searched[i] = i % 4 == 3 ? 100000 + (unsigned int) i : cars[(random >> 33) % fleets[f]];
+        }
+        highwayAddStation(highway, (unsigned int) f, cars, fleets[f]);
+        heap = searchStation(&highway->index, (unsigned int) f)->cars;
+        rounds = 4096 / fleets[f] + 16;
+
+        printf("%s\n    {\"cars\": %d", f > 0 ? "," : "", fleets[f]);
+        for(kernel = 0; kernel < 4; kernel++) {
+#ifdef CAR_SCAN_SIMD
+            if(kernel == 2 && !__builtin_cpu_supports("avx2")) {
+                printf(", \"%s_ns\": null", names[kernel]);
+                continue;
+            }
+#else
+            if(kernel == 1 || kernel == 2) {
+                printf(", \"%s_ns\": null", names[kernel]);
+                continue;
+            }
+#endif
+            clock_gettime(CLOCK_MONOTONIC, &before);
+            for(round = 0; round < rounds; round++) {
+                for(i = 0; i < 1024; i++) {
+                    if(kernel == 0)
+                        found += scanCarsScalar(cars, fleets[f], searched[i]);
+#ifdef CAR_SCAN_SIMD
+                    else if(kernel == 1)
+                        found += fleets[f] >= 4 ? scanCarsSse2(cars, fleets[f], searched[i]) : scanCarsScalar(cars, fleets[f], searched[i]);
+                    else if(kernel == 2)
+                        found += fleets[f] >= 8 ? scanCarsAvx2(cars, fleets[f], searched[i]) : scanCarsScalar(cars, fleets[f], searched[i]);
+#endif
+                    else
+                        found += findCar(heap, searched[i]) >= 0;
+                }
+            }
+            clock_gettime(CLOCK_MONOTONIC, &after);
+            elapsed = (unsigned long long) (after.tv_sec - before.tv_sec) * 1000000000ULL + (after.tv_nsec - before.tv_nsec);
+            printf(", \"%s_ns\": %.2f", names[kernel], (double) elapsed / (1024.0 * rounds));
+        }
+        printf("}");
+    }
+    printf("\n  ],\n  \"found\": %ld\n}\n", found);
+    freeHighway(highway);
+}
+#endif
+
+void planRoute(Highway* highway, unsigned int start, unsigned int end) {
+    const unsigned int* route;
+    int numberOfStops;
+
+    if(start == end) {
+        exit(9);
+    }
+
+    route = findRoute(highway, start, end, &numberOfStops); //written straight from the planner or the route cache, however long
+    writeRoute(route, numberOfStops);
+}
+
+void writeRoute(const unsigned int* stops, int numberOfStops) {
+    int i;
+
+    if(numberOfStops == 0) {
+        writeText("nessun percorso\n");
+        return;
+    }
+    for(i = 0; i < numberOfStops - 1; i++) {
+        writeUnsigned(stops[i]);
+        writeChar(' ');
+    }
+    writeUnsigned(stops[numberOfStops - 1]);
+    writeChar('\n');
+}
+
+void reportRouteCache() {
+    fprintf(stderr, "route cache: %lu hits, %lu misses, %lu invalidations, %d routes cached\n",
+            commandHighway->routes.hits, commandHighway->routes.misses, commandHighway->routes.invalidations,
+            commandHighway->routes.numberOfRoutes);
+}
+
+void reportPoolOccupancy() {
+    Pool* pools[] = {&commandHighway->index.leafPool, &commandHighway->index.innerPool, &commandHighway->index.carsPool};
+    unsigned int i;
 
-            case RMVSTATION:
-                readInt(&stationID);    //read the station id
-                if(removeStation(&root, stationID) == 0){ //if the station is not in the tree
-                    printf("non demolita\n");
-                }
-                else{ //if the station was removed
-                    printf("demolita\n");
-                }
-                break;
-            case ADDCAR:
-                readInt(&stationID); //read the station id
-                station = searchStation(&root, stationID); //search for the station in the tree
-                if(station == NULL) {
-                    readInt(&carID);
-                    printf("non aggiunta\n");
-                } else {
-                    readInt(&carID); //read the car id
-                    addCar(station->cars, carID);//insertLinked the car in the station
-                    printf("aggiunta\n");
-                }
-                break;
-            case RMVCAR:
-                readInt(&stationID); //read the station id
-                station = searchStation(&root, stationID);  //search for the station in the tree
-                if(station == NULL) {
-                    readInt(&carID);
-                    printf("non rottamata\n");
-                } else {
-                    readInt(&carID); //read the car id
-                    if(removeCar(station->cars, carID)) { //the car was in the station
-                        printf("rottamata\n");
-                    } else { //the car was not in the station
-                        printf("non rottamata\n");
-                    }
-                }
-                break;
-            case PLANROUTE:
-                readInt(&stationID); //read the station id
-                readInt(&carID); //reads the second station id
-                planRoute(root, stationID, carID); //plans the route
-                break;
-            default:
-                printf("invalid action\n");
-                exit(5);
-        }
+    for(i = 0; i < sizeof(pools) / sizeof(pools[0]); i++) {
+        fprintf(stderr, "pool %s: %u/%u objects in use (%zu bytes each, %zu bytes reserved)\n",
+                pools[i]->name, pools[i]->objectsInUse, pools[i]->capacity, pools[i]->objectSize,
+                pools[i]->capacity * pools[i]->objectSize);
     }
-    return 0;
+}
+#endif
+
+Highway* createHighway() {
+    Highway* highway = (Highway*) malloc(sizeof(Highway));
+
+    if(highway == NULL)
+        return NULL;
+    initStationIndex(&highway->index, &highway->routes);
+    initRouteCache(&highway->routes);
+    initPlannerWorkspace(&highway->planner);
+#ifdef HIGHWAY_JUMP_INDEX
+    initJumpIndex(&highway->jumps);
+#endif
+    return highway;
+}
+
+void freeHighway(Highway* highway) {
+    if(highway == NULL)
+        return;
+    freeStationIndex(&highway->index);
+    releasePool(&highway->index.leafPool);
+    releasePool(&highway->index.innerPool);
+    releasePool(&highway->index.carsPool);
+    freeRouteCache(&highway->routes);
+    freePlannerWorkspace(&highway->planner);
+#ifdef HIGHWAY_JUMP_INDEX
+    freeJumpIndex(&highway->jumps);
+#endif
+    free(highway);
 }
 
-int planRouteReverseOrder(pStation root, unsigned int start, unsigned int end) {
-    if(root == NULL)
+int highwayAddStation(Highway* highway, unsigned int stationID, const unsigned int* cars, int numberOfCars) {
+    pStation station = addStation(&highway->index, stationID);
+    int i;
+
+    if(station == NULL)
         return 0;
-    //printf("\nPlanning Route in Reverse from %u to %u\n", start, end);
-    pStation currentStation = root;
-    pLinkedList listOfCandidates = newLinkedList();
-    pElement currentElement = NULL;
-    pElement bestCandidate = NULL;
-    // Create an empty vector that will be used to store all the stations in the range, allowing to retrieve each station at each step
-    pVector stations = newVector((int) (numberOfStations * VECTOR_SIZE_FACTOR));
-    // Create an empty vector that will be used to store the predecessors of each station. This will allow to retrieve the path at the end
-    pVector predecessors = newVector((int) (numberOfStations * VECTOR_SIZE_FACTOR));
-    // Create a variable to store the current maximum range, initialized to the start station
-    int currentMinRange = TMP_MAX;
-    // Create a variable to store the index of the station with the current maximum range, initialized to 0
-    unsigned int currentMinStationIndex = 0;
-    int index = 0;
-    int steps = 0;
-    pStation stack[numberOfStations];
-    int topElementStack = -1;
-
-    while (currentStation != NULL || topElementStack != -1) {
-        // Reach the right most Node of the current Node
-        while (currentStation != NULL) {
-            stack[++topElementStack] = currentStation;
-            currentStation = currentStation->right;
-        }
+    for(i = 0; i < numberOfCars; i++)
+        addCar(&highway->index, station, cars[i]);
+    return 1;
+}
 
-        // BackTrack from the empty subtree and visit the Node at the top of the stack
-        currentStation = stack[topElementStack--];
-        if(currentStation->stationID <= start && currentStation->stationID>= end) {
-            /*
-                 * For the first station the currentMinRange is initialized to the stationID - the maximum range of the cars in the initial station
-                 * Its index is initialized to 0, every starting station is always 0
-                 */
-            if(currentStation->stationID == start) { //this takes care of the initialization
-                addVector(predecessors, 0);
-                addVector(stations, currentStation->stationID);
-                currentMinRange = (int) currentStation->stationID - (int) currentStation->cars->array[0];
-                currentMinStationIndex = 0;
-                //printf("\nStart: %u - MinRange: %d\n", currentStation->stationID, currentMinRange);
-            } else {
-                //We immediately add the station to the list of stations so that we can retrieve it later
-                addVector(stations, currentStation->stationID);
-                //printf("\nStation: %u - fi: %d\n", currentStation->stationID, (int) currentStation->stationID - (int) currentStation->cars->array[0]);
-
-                /*
-                 * When the current station cannot reach the next station,
-                 * we dequeue the next possible route until a viable route is found or the queue is empty.
-                 */
-                if((int) currentMinRange > (int) currentStation->stationID) {
-
-                    //if there is not the best candidate we stop
-                    if (listOfCandidates->head == NULL) {
-                        //printf("cannot reach station with %d\n", currentMinRange);
-                        freeVector(stations);
-                        freeVector(predecessors);
-                        freeLinkedList(listOfCandidates);
-                        return 0;
-                    }
-                    //if the linked list has at least one element, we have to look for the best station (lower number of steps tp reach the new station and the further away)
-                   currentElement = listOfCandidates->head;
-                    while(currentElement != NULL) {
-                        if(currentElement->minRange <= (int) currentStation->stationID) {//if the element can reach the new station
-                            if(currentMinRange <= (int) stations->array[currentElement->stationIndex]) { //and if the current station can reach the new element
-                                if(bestCandidate == NULL)
-                                    bestCandidate = currentElement; //it becomes the best candidate
-                                else {
-                                    if(currentElement->steps < bestCandidate->steps) //if we find a station that can do the same but in less steps
-                                        bestCandidate = currentElement;
-                                }
-                            }
-                        }
-                        currentElement = currentElement->next;
-                    }
-                    if(bestCandidate == NULL)
-                        return 0;
-                    currentMinRange = bestCandidate->minRange;
-                    steps = bestCandidate->steps + 1;
-                    currentMinStationIndex = bestCandidate->stationIndex;
-                    //printf("Dequeued: %u - fi %d - steps %d\n", stations->array[bestCandidate->stationIndex], currentMinRange, steps);
-                    bestCandidate = NULL;
-                }
+int highwayRemoveStation(Highway* highway, unsigned int stationID) {
+    return removeStation(&highway->index, stationID);
+}
 
-                /*
-                 * We check if the new station has a longer range than the current maximum range, in this case we save it.
-                 * The queue allows us to be sure not to miss any station with a longer range than the current maximum range
-                 */
-                if(currentMinRange >= (int) currentStation->stationID - (int) currentStation->cars->array[0])
-                    if(currentStation->stationID != end && currentStation->cars->numOfCars > 0) {
+int highwayAddCar(Highway* highway, unsigned int stationID, unsigned int carID) {
+    pStation station = writableStation(&highway->index, stationID); //its reach may change
 
-                        insertLinked(listOfCandidates,
-                                     (int) currentStation->stationID - (int) currentStation->cars->array[0], index, steps);
-                        //printf("Enqueued: %u - fi %d - steps %d\n", currentStation->stationID, listOfCandidates->head->minRange, steps);
-                    }
+    if(station == NULL)
+        return 0;
+    addCar(&highway->index, station, carID);
+    return 1;
+}
 
-                addVector(predecessors, currentMinStationIndex);
-            }
-            index ++;
-            if(currentStation->stationID == end)
-                break;
+int highwayRemoveCar(Highway* highway, unsigned int stationID, unsigned int carID) {
+    pStation station = writableStation(&highway->index, stationID); //its reach may change
+
+    if(station == NULL)
+        return 0;
+    return removeCar(&highway->index, station, carID);
+}
+
+int highwayPlanRoute(Highway* highway, unsigned int start, unsigned int end, unsigned int* stops, int capacity) {
+    const unsigned int* route;
+    int numberOfStops;
+
+    if(start == end) {// The planners need two different stations, the route is the station itself
+        if(searchStation(&highway->index, start) == NULL)
+            return 0;
+        if(capacity > 0)
+            stops[0] = start;
+        return 1;
+    }
+
+    route = findRoute(highway, start, end, &numberOfStops);
+    if(numberOfStops > 0 && capacity > 0)
+        memcpy(stops, route, (numberOfStops < capacity ? numberOfStops : capacity) * sizeof(unsigned int));
+    return numberOfStops;
+}
+
+int highwayCountStops(Highway* highway, unsigned int start, unsigned int end) {
+    int numberOfStops;
+#ifdef HIGHWAY_JUMP_INDEX
+    unsigned long misses = highway->routes.misses;
+#endif
+
+    if(start == end)
+        return searchStation(&highway->index, start) != NULL;
+#ifdef HIGHWAY_JUMP_INDEX
+    if(highway->jumps.changes == highway->routes.changes)
+        return countJumps(&highway->jumps, start, end);
+#endif
+    findRoute(highway, start, end, &numberOfStops);
+#ifdef HIGHWAY_JUMP_INDEX
+    // A route that was planned would have been counted by the index, findRoute already charged the ones without stops
+    if(numberOfStops > 0 && highway->routes.misses != misses)
+        chargeJumpIndex(highway, highway->planner.visited);
+#endif
+    return numberOfStops;
+}
+
+int highwaySaveSnapshot(Highway* highway, const char* path) {
+    return saveSnapshot(&highway->index, path);
+}
+
+int highwayLoadSnapshot(Highway* highway, const char* path) {
+    return loadSnapshot(&highway->index, path);
+}
+
+const unsigned int* findRoute(Highway* highway, unsigned int start, unsigned int end, int* numberOfStops) {
+    RouteCacheEntry* entry = lookupRoute(&highway->routes, start, end);
+
+    if(entry != NULL) {
+        *numberOfStops = entry->numberOfStops;
+        return entry->stops;
+    }
+
+    resetPlannerWorkspace(&highway->planner);
+#ifdef HIGHWAY_JUMP_INDEX
+    if(highway->jumps.changes == highway->routes.changes && countJumps(&highway->jumps, start, end) == 0) {
+        *numberOfStops = 0; //no route, the planners would walk the whole interval to find out
+        return highway->planner.route->array;
+    }
+#endif
+    COUNT(routesPlanned, 1);
+    if(start > end)
+        planRouteReverseOrder(&highway->index, start, end, &highway->planner);
+    else
+        planRouteInOrder(&highway->index, start, end, &highway->planner);
+    COUNT(reachesRead, highway->planner.visited);
+    storeRoute(&highway->routes, start, end, highway->planner.route);
+#ifdef HIGHWAY_JUMP_INDEX
+    // The planners of the routes only skip the queries with no route
+    if(highway->planner.route->numberOfElements == 0)
+        chargeJumpIndex(highway, highway->planner.visited);
+#endif
+    *numberOfStops = highway->planner.route->numberOfElements;
+    return highway->planner.route->array;
+}
+
+#ifdef HIGHWAY_JUMP_INDEX
+void initJumpIndex(JumpIndex* jumps) {
+    memset(jumps, 0, sizeof(JumpIndex));
+    jumps->changes = ULONG_MAX; //the route cache starts from 0 changes
+}
+
+void freeJumpIndex(JumpIndex* jumps) {
+    free(jumps->stations);
+    initJumpIndex(jumps);
+}
+
+void buildJumpIndex(Highway* highway) {
+    JumpIndex* jumps = &highway->jumps;
+    int numberOfStations = (int) highway->index.numberOfStations;
+    StationCursor cursor;
+    pStation station;
+    int* block;
+    int first;
+    int i;
+
+    if(numberOfStations > jumps->capacity) {// The arrays are rebuilt from scratch, their content is not kept
+        free(jumps->stations);
+        jumps->capacity = numberOfStations > 2 * jumps->capacity ? numberOfStations : 2 * jumps->capacity;
+        block = (int*) malloc((size_t) jumps->capacity * JUMP_INDEX_ARRAYS * sizeof(int));
+        if(block == NULL) {
+            exit(16);
         }
-        // We have visited the Node and its right subtree. Now, it's left subtree's turn
-        currentStation = currentStation->left;
+        jumps->stations = (unsigned int*) block;
+        jumps->forward.reach = block + jumps->capacity;
+        jumps->forward.parent = block + 2 * jumps->capacity;
+        jumps->forward.jump = block + 3 * jumps->capacity;
+        jumps->forward.depth = block + 4 * jumps->capacity;
+        jumps->backward.reach = block + 5 * jumps->capacity;
+        jumps->backward.parent = block + 6 * jumps->capacity;
+        jumps->backward.jump = block + 7 * jumps->capacity;
+        jumps->backward.depth = block + 8 * jumps->capacity;
+        jumps->stack = block + 9 * jumps->capacity;
     }
-    pVector path = newVector((int) (numberOfStations * VECTOR_SIZE_FACTOR));
-    index = stations->numberOfElements - 1;
 
-    while(index != 0){
-        addVector(path, stations->array[index]);
-        index = (int) predecessors->array[index];
+    i = 0;
+    for(station = seekStation(&highway->index, 0, &cursor); station != NULL; station = nextStation(&cursor))
+        jumps->stations[i++] = station->stationID;
+    jumps->numberOfStations = numberOfStations;
+
+    // The reach of every station becomes the last position it reaches, counted from its end of the highway
+    i = 0;
+    for(station = seekStation(&highway->index, 0, &cursor); station != NULL; station = nextStation(&cursor), i++) {
+        jumps->forward.reach[i] = countStationsUpTo(jumps, station->forwardReach) - 1;
+        first = station->backwardReach <= 0 ? 0 : countStationsUpTo(jumps, (unsigned int) station->backwardReach - 1);
+        jumps->backward.reach[numberOfStations - 1 - i] = numberOfStations - 1 - first;
     }
-    addVector(path, stations->array[0]);
-    for(index = path->numberOfElements - 1; index >= 1; index--){
-        printf("%u ", path->array[index]);
+    buildJumpChain(&jumps->forward, jumps->stack, numberOfStations);
+    buildJumpChain(&jumps->backward, jumps->stack, numberOfStations);
+    jumps->changes = highway->routes.changes;
+    jumps->work = 0;
+}
+
+void chargeJumpIndex(Highway* highway, unsigned long reaches) {
+    JumpIndex* jumps = &highway->jumps;
+    unsigned long numberOfStations = highway->index.numberOfStations;
+
+    if(jumps->changes == highway->routes.changes || numberOfStations == 0)
+        return;
+    if(jumps->workChanges != highway->routes.changes) {// The work before the last change would not have been saved
+        jumps->workChanges = highway->routes.changes;
+        jumps->work = 0;
     }
-    printf("%u", path->array[0]);
-    printf("\n");
+    jumps->work += reaches;
+    // Measured, a rebuild takes about as long as the planners reading n log2(n) reaches
+    if(jumps->work >= numberOfStations * (64 - __builtin_clzll(numberOfStations)))
+        buildJumpIndex(highway);
+}
 
-    freeVector(path);
-    freeVector(stations);
-    freeVector(predecessors);
-    freeLinkedList(listOfCandidates);
-    return 1;
+void buildJumpChain(JumpChain* chain, int* stack, int numberOfStations) {
+    int top = numberOfStations; //the stack is stack[top..numberOfStations - 1], with increasing positions and reaches
+    int position;
+    int parent;
+    int low;
+    int high;
+    int middle;
+
+    for(position = numberOfStations - 1; position >= 0; position--) {
+        // The positions after this one that do not reach further than it are never the best stop again
+        while(top < numberOfStations && chain->reach[stack[top]] <= chain->reach[position])
+            top++;
+        stack[--top] = position;
+
+        // The parent is the last position of the stack within reach, it reaches further than any other
+        low = top;
+        high = numberOfStations - 1;
+        while(low < high) {
+            middle = low + (high - low + 1) / 2;
+            if(stack[middle] <= chain->reach[position])
+                low = middle;
+            else
+                high = middle - 1;
+        }
+        parent = stack[low];
+        chain->parent[position] = parent;
+
+        if(parent == position) {
+            chain->jump[position] = position;
+            chain->depth[position] = 0;
+        } else {
+            // Skew binary jumps: two jumps of the same length from the parent merge into one, as in the binary lifting tables
+            chain->depth[position] = chain->depth[parent] + 1;
+            if(chain->depth[parent] - chain->depth[chain->jump[parent]] ==
+               chain->depth[chain->jump[parent]] - chain->depth[chain->jump[chain->jump[parent]]])
+                chain->jump[position] = chain->jump[chain->jump[parent]];
+            else
+                chain->jump[position] = parent;
+        }
+    }
 }
 
-int planRouteInOrder(pStation root, unsigned int start, unsigned int end) {
-    if(root == NULL)
+int countStationsUpTo(JumpIndex* jumps, unsigned int stationID) {
+    int low = 0;
+    int high = jumps->numberOfStations;
+    int middle;
+
+    while(low < high) {
+        middle = low + (high - low) / 2;
+        if(jumps->stations[middle] <= stationID)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+int countJumps(JumpIndex* jumps, unsigned int start, unsigned int end) {
+    JumpChain* chain = &jumps->forward;
+    int from = countStationsUpTo(jumps, start) - 1;
+    int to = countStationsUpTo(jumps, end) - 1;
+    int position;
+
+    if(from < 0 || to < 0 || jumps->stations[from] != start || jumps->stations[to] != end)
         return 0;
-    //printf("\nPlanning Route in order from %u to %u\n", start, end);
-    pStation currentStation = root;
-    // Create an empty queue that will be used to store the stations that have longer range than the current station
-    pQueue maxRanges = newQueue();
-    // Create an empty vector that will be used to store all the stations in the range, allowing to retrieve each station at each step
-    pVector stations = newVector((int) (numberOfStations * VECTOR_SIZE_FACTOR));
-    // Create an empty vector that will be used to store the predecessors of each station. This will allow to retrieve the path at the end
-    pVector predecessors = newVector((int) (numberOfStations * VECTOR_SIZE_FACTOR));
-    // Create a variable to store the current maximum range, initialized to the start station
-    unsigned int currentMaxRange = 0;
-    // Create a variable to store the index of the station with the current maximum range, initialized to 0
-    unsigned int currentMaxStationIndex = 0;
-    int index = 0;
-    pEntry entry;
-    pStation stack[numberOfStations];
-    int topElementStack = -1;
-
-    while (currentStation != NULL || topElementStack != -1) {
-        while (currentStation != NULL) {
-            // Push the current node into the stack
-            stack[++topElementStack] = currentStation;
-            // Move to the left child
-            currentStation = currentStation->left;
-        }
+    if(start > end) {
+        chain = &jumps->backward;
+        from = jumps->numberOfStations - 1 - from;
+        to = jumps->numberOfStations - 1 - to;
+    }
 
-        // The current node is NULL at this point. We have to pop an element from the stack
-        currentStation = stack[topElementStack--];
-
-        // The current node should be in the given range
-        if (currentStation->stationID >= start && currentStation->stationID <= end) { //from this point on the stations are in the range
-
-                /*
-                 * For the first station the currentMaxRange is initialized to the stationID + the maximum range of the cars in the initial station
-                 * Its index is initialized to 0, every starting station is always 0
-                 */
-                if(currentStation->stationID == start) { //this takes care of the initialization
-                    addVector(predecessors, 0);
-                    addVector(stations, currentStation->stationID);
-                    currentMaxRange = currentStation->stationID + currentStation->cars->array[0];
-                    currentMaxStationIndex = 0;
-                    //printf("\nStart: %u - MaxRange: %d\n", currentStation->stationID, currentMaxRange);
-                } else {
+    // The reach only grows along the parents, so every jump that does not reach the end can be taken
+    position = from;
+    while(chain->reach[position] < to) {
+        if(chain->parent[position] == position)
+            return 0;
+        if(chain->reach[chain->jump[position]] < to)
+            position = chain->jump[position];
+        else
+            position = chain->parent[position];
+    }
+    return chain->depth[from] - chain->depth[position] + 2;
+}
+#endif
 
-                    //We immediately add the station to the list of stations so that we can retrieve it later
-                    addVector(stations, currentStation->stationID);
-                    //printf("\nStation: %u - fi: %d\n", currentStation->stationID, (int) currentStation->stationID - (int) currentStation->cars->array[0]);
-                    /*
-                     * When the current station cannot reach the next station,
-                     * we dequeue the next possible route until a viable route is found or the queue is empty.
-                     */
-                    while(currentMaxRange < currentStation->stationID) {   //fMax < Si+1
-                        entry = dequeue(maxRanges);
-                        //if the queue is empty there is no viable route
-                        if(entry == NULL) {
-                           // printf("cannot reach station with %d\n", currentMaxRange);
-                            free(entry);
-                            freeVector(stations);
-                            freeVector(predecessors);
-                            freeQueue(maxRanges);
-                            return 0;
-                        }
-                        //if the queue is not empty we dequeue the next possible station and if we can reach the dequeued station we update the current maximum range
-                        if(currentMaxRange >= stations->array[entry->stationIndex]) {
-                            currentMaxRange = entry->maxRange;
-                            currentMaxStationIndex = entry->stationIndex;
-                            //printf("Dequeued: %u - MinRange: %d\n", stations->array[entry->stationIndex], currentMaxRange);
-                        } else {
-                            //printf("cannot reach station with %d\n", currentMaxRange);
-                            free(entry);
-                            freeVector(stations);
-                            freeVector(predecessors);
-                            freeQueue(maxRanges);
-                            return 0;
-                        }
-                        free(entry);
-                    }
-
-                    /*
-                     * We check if the new station has a longer range than the current maximum range, in this case we save it in the queue.
-                     * The queue allows us to be sure not to miss any station with a longer range than the current maximum range
-                     */
-                    if(currentStation->cars->numOfCars > 0 && currentMaxRange < currentStation->stationID + currentStation->cars->array[0] ) //fMax < fSi+1
-                        if(currentStation->stationID != end &&
-                           (maxRanges->tail == NULL || maxRanges->tail->maxRange < currentStation->stationID + currentStation->cars->array[0])) {
-                            enqueue(maxRanges, (int) currentStation->stationID + (int) currentStation->cars->array[0], index);
-                            //("Enqueued: %u - fi %d\n", currentStation->stationID, (int) currentStation->stationID - (int) currentStation->cars->array[0]);
-                        }
-
-                    addVector(predecessors, currentMaxStationIndex);
-                }
+/*
+ * Routing engine shared by the two directions. DEFINE_ROUTE_ENGINE expands it once for each direction with towardsEnd
+ * a constant, so every test of the direction is resolved by the compiler and both planners run the same loops with no
+ * direction check left in them. Towards the end of the highway a level grows with forwardReach and the last leaf
+ * visited is next to the following level, towards the start it grows with backwardReach and the first leaf is.
+ * Comments are C style because the body is a macro.
+ */
+#define DEFINE_ROUTE_ENGINE(planRoute, reachInNode, findReaching, towardsEnd) \
+int planRoute(pStationIndex index, unsigned int start, unsigned int end, PlannerWorkspace* workspace) { \
+    /* For each number of steps, the station furthest from start reached with it */ \
+    pVector levelEnds = workspace->levelEnds; \
+    pVector route = workspace->route; \
+    ReachRange range = {.low = start, .high = start}; \
+    pStation station; \
+    int step; \
+    \
+    if(searchStation(index, start) == NULL || searchStation(index, end) == NULL) \
+        return 0; \
+    \
+    /* \
+     * Breadth first search by levels: the stations reachable with one more step are the ones right after the level \
+     * in the direction of end, up to the reach of the level. The reach of each level is read from the station index, \
+     * which visits only the subtrees partly inside the level. \
+     */ \
+    addVector(levelEnds, start); \
+    while(towardsEnd ? range.high < end : range.low > end) { \
+        range.forwardReach = 0; \
+        range.backwardReach = INT_MAX; \
+        if(inLastLeaf(&range)) { \
+            reachInNode(range.leaf, 0, range.leafLow, range.leafHigh, &range); \
+        } else { \
+            range.leaf = NULL; \
+            reachInNode(index->root, index->height, 0, UINT_MAX, &range); \
+        } \
+        if(towardsEnd) { \
+            if(range.forwardReach <= range.high) /* The level cannot reach any new station */ \
+                break; \
+            range.low = range.high + 1; \
+            range.high = range.forwardReach < end ? range.forwardReach : end; \
+            addVector(levelEnds, range.high); \
+        } else { \
+            if(range.backwardReach >= 0 && (unsigned int) range.backwardReach >= range.low) \
+                break; \
+            range.high = range.low - 1; \
+            range.low = range.backwardReach <= 0 || (unsigned int) range.backwardReach < end ? end : (unsigned int) range.backwardReach; \
+            addVector(levelEnds, range.low); \
+        } \
+    } \
+    if(towardsEnd ? range.high < end : range.low > end) { \
+        workspace->visited += range.visited; \
+        return 0; \
+    } \
+    \
+    /* \
+     * The route is rebuilt from end: at each level the stop is the station closest to the start of the highway \
+     * that can reach the following stop, since the stop belongs to the next level one always does. \
+     */ \
+    addVector(route, end); \
+    range.target = end; \
+    for(step = levelEnds->numberOfElements - 2; step >= 0; step--) { \
+        if(towardsEnd) { \
+            range.low = step > 0 ? levelEnds->array[step - 1] + 1 : start; \
+            range.high = levelEnds->array[step]; \
+        } else { \
+            range.low = levelEnds->array[step]; \
+            range.high = step > 0 ? levelEnds->array[step - 1] - 1 : start; \
+        } \
+        if(inLastLeaf(&range)) \
+            station = findReaching(range.leaf, 0, range.leafLow, range.leafHigh, &range); \
+        else \
+            station = findReaching(index->root, index->height, 0, UINT_MAX, &range); \
+        range.target = station->stationID; \
+        addVector(route, range.target); \
+    } \
+    workspace->visited += range.visited; \
+    reverseVector(route); \
+    return 1; \
+} \
+\
+void reachInNode(void* node, int height, unsigned int lowBound, unsigned int highBound, ReachRange* range) { \
+    pInnerNode inner; \
+    pLeaf leaf; \
+    unsigned int childLow; \
+    unsigned int childHigh; \
+    int last; \
+    int i; \
+    \
+    if(height == 0) { \
+        leaf = (pLeaf) node; \
+        for(i = findSlot(leaf, range->low); i < leaf->numberOfStations && leaf->stations[i].stationID <= range->high; i++) { \
+            if(towardsEnd && leaf->stations[i].forwardReach > range->forwardReach) \
+                range->forwardReach = leaf->stations[i].forwardReach; \
+            if(!towardsEnd && leaf->stations[i].backwardReach < range->backwardReach) \
+                range->backwardReach = leaf->stations[i].backwardReach; \
+            range->visited++; \
+        } \
+        /* The next range of the planner starts next to the last leaf in its direction */ \
+        if(towardsEnd || range->leaf == NULL) { \
+            range->leaf = leaf; \
+            range->leafLow = lowBound; \
+            range->leafHigh = highBound; \
+        } \
+        return; \
+    } \
+    \
+    inner = (pInnerNode) node; \
+    last = findChild(inner, range->high); \
+    for(i = findChild(inner, range->low); i <= last; i++) { \
+        childLow = i > 0 ? inner->keys[i - 1] : lowBound; \
+        childHigh = i < inner->numberOfKeys ? inner->keys[i] - 1 : highBound; \
+        range->visited++; \
+        if(childLow >= range->low && childHigh <= range->high) { /* The whole child is inside the range */ \
+            if(towardsEnd && inner->forwardReach[i] > range->forwardReach) \
+                range->forwardReach = inner->forwardReach[i]; \
+            if(!towardsEnd && inner->backwardReach[i] < range->backwardReach) \
+                range->backwardReach = inner->backwardReach[i]; \
+        } else { \
+            reachInNode(inner->children[i], height - 1, childLow, childHigh, range); \
+        } \
+    } \
+} \
+\
+pStation findReaching(void* node, int height, unsigned int lowBound, unsigned int highBound, ReachRange* range) { \
+    pInnerNode inner; \
+    pLeaf leaf; \
+    pStation station; \
+    unsigned int childLow; \
+    unsigned int childHigh; \
+    int last; \
+    int i; \
+    \
+    if(height == 0) { \
+        leaf = (pLeaf) node; \
+        for(i = findSlot(leaf, range->low); i < leaf->numberOfStations && leaf->stations[i].stationID <= range->high; i++) { \
+            range->visited++; \
+            station = &leaf->stations[i]; \
+            if(towardsEnd ? station->forwardReach >= range->target : \
+                            station->backwardReach < 0 || (unsigned int) station->backwardReach <= range->target) { \
+                /* The next range searched by the planner is next to the station */ \
+                range->leaf = leaf; \
+                range->leafLow = lowBound; \
+                range->leafHigh = highBound; \
+                return station; \
+            } \
+        } \
+        return NULL; \
+    } \
+    \
+    inner = (pInnerNode) node; \
+    last = findChild(inner, range->high); \
+    for(i = findChild(inner, range->low); i <= last; i++) { \
+        range->visited++; \
+        /* A child whose reach does not get to the target has no station that does */ \
+        if(towardsEnd ? inner->forwardReach[i] < range->target : \
+                        inner->backwardReach[i] >= 0 && (unsigned int) inner->backwardReach[i] > range->target) \
+            continue; \
+        childLow = i > 0 ? inner->keys[i - 1] : lowBound; \
+        childHigh = i < inner->numberOfKeys ? inner->keys[i] - 1 : highBound; \
+        station = findReaching(inner->children[i], height - 1, childLow, childHigh, range); \
+        if(station != NULL) \
+            return station; \
+    } \
+    return NULL; \
+}
 
-                index++;
-            if(currentStation->stationID == end)
-                break;
+DEFINE_ROUTE_ENGINE(planRouteInOrder, reachInNodeInOrder, findReachingInOrder, 1)
+DEFINE_ROUTE_ENGINE(planRouteReverseOrder, reachInNodeReverseOrder, findReachingReverseOrder, 0)
+
+int inLastLeaf(ReachRange* range) {
+    return range->leaf != NULL && range->leafLow <= range->low && range->high <= range->leafHigh;
+}
+
+void initRouteCache(RouteCache* cache) {
+    int i;
+
+    for(i = 0; i < (1 << ROUTE_CACHE_BITS); i++) {
+        cache->low[i] = 1;
+        cache->high[i] = 0;
+        cache->entries[i].stops = NULL;
+        cache->entries[i].capacity = 0;
+    }
+    cache->numberOfRoutes = 0;
+    cache->coveredLow = 1;
+    cache->coveredHigh = 0;
+    cache->hits = cache->misses = cache->invalidations = cache->changes = 0;
+}
+
+void clearRouteCache(RouteCache* cache) {
+    int i;
+
+    for(i = 0; i < (1 << ROUTE_CACHE_BITS); i++) {
+        cache->low[i] = 1;
+        cache->high[i] = 0;
+    }
+    cache->numberOfRoutes = 0;
+    cache->coveredLow = 1;
+    cache->coveredHigh = 0;
+    cache->changes++; //the stations may have been dropped without invalidating the routes
+}
+
+void freeRouteCache(RouteCache* cache) {
+    int i;
+
+    for(i = 0; i < (1 << ROUTE_CACHE_BITS); i++)
+        free(cache->entries[i].stops);
+}
+
+unsigned int routeSlot(unsigned int start, unsigned int end) {
+    return ((start * 2654435761U) ^ (end * 2246822519U)) >> (32 - ROUTE_CACHE_BITS);
+}
+
+RouteCacheEntry* lookupRoute(RouteCache* cache, unsigned int start, unsigned int end) {
+    unsigned int slot = routeSlot(start, end);
+    RouteCacheEntry* entry = &cache->entries[slot];
+
+    if(cache->low[slot] <= cache->high[slot] && entry->start == start && entry->end == end) {
+        cache->hits++;
+        return entry;
+    }
+    cache->misses++;
+    return NULL;
+}
+
+void storeRoute(RouteCache* cache, unsigned int start, unsigned int end, pVector route) {
+    unsigned int slot = routeSlot(start, end);
+    RouteCacheEntry* entry = &cache->entries[slot];
+    unsigned int* stops;
+
+    if(route->numberOfElements > ROUTE_CACHE_MAX_STOPS)
+        return;
+
+    if(entry->capacity < route->numberOfElements) {
+        stops = (unsigned int*) realloc(entry->stops, route->numberOfElements * sizeof(unsigned int));
+        if(stops == NULL)
+            return; //the route is simply not cached
+        entry->stops = stops;
+        entry->capacity = route->numberOfElements;
+    }
+
+    if(cache->low[slot] > cache->high[slot])
+        cache->numberOfRoutes++;
+    entry->start = start;
+    entry->end = end;
+    entry->numberOfStops = route->numberOfElements;
+    if(route->numberOfElements > 0) //an empty route may have no stops array at all
+        memcpy(entry->stops, route->array, route->numberOfElements * sizeof(unsigned int));
+    cache->low[slot] = start < end ? start : end;
+    cache->high[slot] = start < end ? end : start;
+
+    if(cache->low[slot] < cache->coveredLow || cache->coveredLow > cache->coveredHigh)
+        cache->coveredLow = cache->low[slot];
+    if(cache->high[slot] > cache->coveredHigh)
+        cache->coveredHigh = cache->high[slot];
+}
+
+void invalidateRoutes(RouteCache* cache, unsigned int stationID) {
+    unsigned int coveredLow = 1;
+    unsigned int coveredHigh = 0;
+    int i;
+
+    cache->changes++;
+    // Most changes happen outside every cached interval
+    if(stationID < cache->coveredLow || stationID > cache->coveredHigh)
+        return;
+
+    for(i = 0; i < (1 << ROUTE_CACHE_BITS); i++) {
+        if(cache->low[i] > cache->high[i])
+            continue;
+        if(cache->low[i] <= stationID && stationID <= cache->high[i]) {
+            cache->low[i] = 1;
+            cache->high[i] = 0;
+            cache->numberOfRoutes--;
+            cache->invalidations++;
+            continue;
         }
-        // We have visited the node and its left subtree. Now, it's right subtree's turn
-        currentStation = currentStation->right;
+        // The bounds of the routes left are recomputed on the way
+        if(cache->low[i] < coveredLow || coveredLow > coveredHigh)
+            coveredLow = cache->low[i];
+        if(cache->high[i] > coveredHigh)
+            coveredHigh = cache->high[i];
+    }
+    cache->coveredLow = coveredLow;
+    cache->coveredHigh = coveredHigh;
+}
+
+pStation searchStation(pStationIndex index, unsigned int stationID) {
+    pLeaf leaf;
+    int slot;
+
+    if(index->root == NULL)
+        return NULL;
+
+    leaf = findLeaf(index, stationID, NULL);
+    slot = findSlot(leaf, stationID);
+    if(slot < leaf->numberOfStations && leaf->stations[slot].stationID == stationID)
+        return &leaf->stations[slot];
+    return NULL;
+}
+
+pStation seekStation(pStationIndex index, unsigned int stationID, StationCursor* cursor) {
+    if(index->root == NULL)
+        return NULL;
+
+    cursor->height = index->height;
+    cursor->leaf = findLeaf(index, stationID, &cursor->path);
+    cursor->slot = findSlot(cursor->leaf, stationID);
+    if(cursor->slot == cursor->leaf->numberOfStations) {// Every station of the leaf is smaller, the next one starts with a larger station
+        cursor->slot--;
+        return nextStation(cursor);
     }
+    return &cursor->leaf->stations[cursor->slot];
+}
+
+pStation nextStation(StationCursor* cursor) {
+    void* node;
+    int level;
 
-    pVector path = newVector((int) (numberOfStations * VECTOR_SIZE_FACTOR));
-    index = stations->numberOfElements - 1;
+    if(++cursor->slot < cursor->leaf->numberOfStations)
+        return &cursor->leaf->stations[cursor->slot];
 
-    while(index != 0){
-        addVector(path, stations->array[index]);
-        index = (int) predecessors->array[index];
+    // Climb to the first node with a child after the one followed, then take the leftmost path under that child
+    for(level = cursor->height - 1; level >= 0 && cursor->path.childIndex[level] == cursor->path.nodes[level]->numberOfKeys; level--);
+    if(level < 0) {
+        cursor->slot = cursor->leaf->numberOfStations;
+        return NULL;
     }
-    addVector(path, stations->array[0]);
-    for(index = path->numberOfElements - 1; index >= 1; index--){
-        printf("%u ", path->array[index]);
+    node = cursor->path.nodes[level]->children[++cursor->path.childIndex[level]];
+    for(level++; level < cursor->height; level++) {
+        cursor->path.nodes[level] = (pInnerNode) node;
+        cursor->path.childIndex[level] = 0;
+        node = cursor->path.nodes[level]->children[0];
     }
-    printf("%u", path->array[0]);
-    printf("\n");
+    cursor->leaf = (pLeaf) node;
+    cursor->slot = 0;
+    return &cursor->leaf->stations[0];
+}
 
-    freeVector(path);
-    freeVector(stations);
-    freeVector(predecessors);
-    freeQueue(maxRanges);
-    return 1;
+pLeaf findLeaf(pStationIndex index, unsigned int stationID, TreePath* path) {
+    void* node = index->root;
+    pInnerNode inner;
+    int position;
+    int level;
+
+    for(level = 0; level < index->height; level++) {
+        inner = (pInnerNode) node;
+        position = findChild(inner, stationID);
+        if(path != NULL) {
+            path->nodes[level] = inner;
+            path->childIndex[level] = position;
+        }
+        node = inner->children[position];
+    }
+
+    return (pLeaf) node;
 }
 
+int findChild(pInnerNode node, unsigned int stationID) {
+    int low = 0;
+    int high = node->numberOfKeys;
+    int middle;
 
-void planRoute(pStation root, unsigned int start, unsigned int end) {
-    if(start == end) {
-        exit(9);
+    // Binary search of the first key greater than stationID, its position is the child to follow
+    while(low < high) {
+        middle = (low + high) / 2;
+        if(node->keys[middle] <= stationID)
+            low = middle + 1;
+        else
+            high = middle;
     }
-    if(start > end) {
-        if(planRouteReverseOrder(root, start, end) == 0) {
-            printf("nessun percorso\n");
-            return;
+    return low;
+}
+
+int refreshChild(pInnerNode node, int position, int isLeaf) {
+    unsigned int forwardReach = 0;
+    int backwardReach = INT_MAX;
+    pLeaf leaf;
+    pInnerNode child;
+    int i;
+
+    if(isLeaf) {
+        leaf = (pLeaf) node->children[position];
+        for(i = 0; i < leaf->numberOfStations; i++) {
+            if(leaf->stations[i].forwardReach > forwardReach)
+                forwardReach = leaf->stations[i].forwardReach;
+            if(leaf->stations[i].backwardReach < backwardReach)
+                backwardReach = leaf->stations[i].backwardReach;
         }
     } else {
-        if(planRouteInOrder(root, start, end) == 0) {
-            printf("nessun percorso\n");
+        child = (pInnerNode) node->children[position];
+        for(i = 0; i <= child->numberOfKeys; i++) {
+            if(child->forwardReach[i] > forwardReach)
+                forwardReach = child->forwardReach[i];
+            if(child->backwardReach[i] < backwardReach)
+                backwardReach = child->backwardReach[i];
+        }
+    }
+    if(node->forwardReach[position] == forwardReach && node->backwardReach[position] == backwardReach)
+        return 0;
+    node->forwardReach[position] = forwardReach;
+    node->backwardReach[position] = backwardReach;
+    return 1;
+}
+
+void refreshReach(pStationIndex index, TreePath* path, int level) {
+    // The reach of a node changes only if the reach of the child followed changed
+    for(; level >= 0; level--) {
+        if(!refreshChild(path->nodes[level], path->childIndex[level], level == index->height - 1))
+            return;
+    }
+}
+
+void extendReach(pStationIndex index, TreePath* path, unsigned int forwardReach, int backwardReach) {
+    pInnerNode node;
+    int position;
+    int level;
+
+    for(level = index->height - 1; level >= 0; level--) {
+        node = path->nodes[level];
+        position = path->childIndex[level];
+        if(node->forwardReach[position] >= forwardReach && node->backwardReach[position] <= backwardReach)
             return;
+        if(node->forwardReach[position] < forwardReach)
+            node->forwardReach[position] = forwardReach;
+        if(node->backwardReach[position] > backwardReach)
+            node->backwardReach[position] = backwardReach;
+    }
+}
+
+void shrinkReach(pStationIndex index, TreePath* path, unsigned int forwardReach, int backwardReach) {
+    pInnerNode parent;
+    int position;
+
+    if(index->height == 0)
+        return;
+    parent = path->nodes[index->height - 1];
+    position = path->childIndex[index->height - 1];
+    if(parent->forwardReach[position] > forwardReach && parent->backwardReach[position] < backwardReach)
+        return;
+    refreshReach(index, path, index->height - 1);
+}
+
+int findSlot(pLeaf leaf, unsigned int stationID) {
+    int low = 0;
+    int high = leaf->numberOfStations;
+    int middle;
+
+    while(low < high) {
+        middle = (low + high) / 2;
+        if(leaf->stations[middle].stationID < stationID)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+pStation addStation(pStationIndex index, unsigned int stationID) {
+    TreePath path;
+    pLeaf leaf;
+    pStation station;
+    int slot;
+
+    if(index->root == NULL) {// If the index is empty
+        index->root = createLeaf(index);
+        index->height = 0;
+    }
+
+    leaf = findLeaf(index, stationID, &path);
+    slot = findSlot(leaf, stationID);
+    if(slot < leaf->numberOfStations && leaf->stations[slot].stationID == stationID) {//WARNING: This is not specified in the assignment you may need to add the cars to the station
+        return NULL;
+    }
+    leaf = writableLeaf(index, &path);
+
+    if(leaf->numberOfStations == LEAF_SIZE) {// If the leaf is full it is split and the station goes in the half that covers it
+        pLeaf sibling = splitLeaf(index, leaf, &path);
+        if(slot > leaf->numberOfStations) {
+            slot -= leaf->numberOfStations;
+            leaf = sibling;
         }
+        findLeaf(index, stationID, &path); //the split may have moved the leaf under other nodes
+        leaf = writableLeaf(index, &path);
     }
+
+    memmove(&leaf->stations[slot + 1], &leaf->stations[slot], (leaf->numberOfStations - slot) * sizeof(Station));
+    leaf->numberOfStations++;
+
+    station = &leaf->stations[slot];
+    station->stationID = stationID;
+    station->forwardReach = stationID;
+    station->backwardReach = (int) stationID;
+    station->cars = createMaxHeap(index);
+    index->numberOfStations++;
+    extendReach(index, &path, station->forwardReach, station->backwardReach);
+    invalidateRoutes(index->routes, stationID);
+    return station;
 }
 
-pStation searchStation(pStation* root, unsigned int stationID) {
-    pStation node = *root;
+pLeaf splitLeaf(pStationIndex index, pLeaf leaf, TreePath* path) {
+    pLeaf sibling = createLeaf(index);
+    int half = leaf->numberOfStations / 2;
 
-    while (node != NULL) {
-        if (stationID == node->stationID)
-            break;
+    sibling->numberOfStations = leaf->numberOfStations - half;
+    memcpy(sibling->stations, &leaf->stations[half], sibling->numberOfStations * sizeof(Station));
+    leaf->numberOfStations = half;
+    COUNT(leafSplits, 1);
+
+    // The new leaf is reached only through its parent, the leaves have no links to their siblings
+    insertChild(index, path, index->height - 1, sibling->stations[0].stationID, sibling);
+    return sibling;
+}
+
+void insertChild(pStationIndex index, TreePath* path, int level, unsigned int key, void* child) {
+    unsigned int keys[INNER_SIZE + 1];
+    void* children[INNER_SIZE + 2];
+    unsigned int forwardReach[INNER_SIZE + 2];
+    int backwardReach[INNER_SIZE + 2];
+    pInnerNode node;
+    pInnerNode sibling;
+    int position;
+    int half;
+    int moved;
+
+    // The child that was split and the new one share the stations of the child, so the reach of the node does not change
+    while(level >= 0) {
+        node = path->nodes[level];
+        position = path->childIndex[level];
+
+        if(node->numberOfKeys < INNER_SIZE) {// There is room for the new child
+            moved = node->numberOfKeys - position;
+            memmove(&node->keys[position + 1], &node->keys[position], moved * sizeof(unsigned int));
+            memmove(&node->children[position + 2], &node->children[position + 1], moved * sizeof(void*));
+            memmove(&node->forwardReach[position + 2], &node->forwardReach[position + 1], moved * sizeof(unsigned int));
+            memmove(&node->backwardReach[position + 2], &node->backwardReach[position + 1], moved * sizeof(int));
+            node->keys[position] = key;
+            node->children[position + 1] = child;
+            node->numberOfKeys++;
+            refreshChild(node, position, level == index->height - 1);
+            refreshChild(node, position + 1, level == index->height - 1);
+            return;
+        }
 
-        if (stationID < node->stationID)
-            node = node->left;
+        // The node is full: the keys are merged with the new one and split in two halves, the middle key goes up
+        COUNT(innerSplits, 1);
+        refreshChild(node, position, level == index->height - 1);
+        moved = INNER_SIZE - position;
+        memcpy(keys, node->keys, position * sizeof(unsigned int));
+        keys[position] = key;
+        memcpy(&keys[position + 1], &node->keys[position], moved * sizeof(unsigned int));
+        memcpy(children, node->children, (position + 1) * sizeof(void*));
+        children[position + 1] = child;
+        memcpy(&children[position + 2], &node->children[position + 1], moved * sizeof(void*));
+        memcpy(forwardReach, node->forwardReach, (position + 1) * sizeof(unsigned int));
+        memcpy(&forwardReach[position + 2], &node->forwardReach[position + 1], moved * sizeof(unsigned int));
+        memcpy(backwardReach, node->backwardReach, (position + 1) * sizeof(int));
+        memcpy(&backwardReach[position + 2], &node->backwardReach[position + 1], moved * sizeof(int));
+
+        half = (INNER_SIZE + 1) / 2;
+        sibling = createInnerNode(index);
+        node->numberOfKeys = half;
+        memcpy(node->keys, keys, half * sizeof(unsigned int));
+        memcpy(node->children, children, (half + 1) * sizeof(void*));
+        memcpy(node->forwardReach, forwardReach, (half + 1) * sizeof(unsigned int));
+        memcpy(node->backwardReach, backwardReach, (half + 1) * sizeof(int));
+        sibling->numberOfKeys = INNER_SIZE - half;
+        memcpy(sibling->keys, &keys[half + 1], sibling->numberOfKeys * sizeof(unsigned int));
+        memcpy(sibling->children, &children[half + 1], (sibling->numberOfKeys + 1) * sizeof(void*));
+        memcpy(sibling->forwardReach, &forwardReach[half + 1], (sibling->numberOfKeys + 1) * sizeof(unsigned int));
+        memcpy(sibling->backwardReach, &backwardReach[half + 1], (sibling->numberOfKeys + 1) * sizeof(int));
+        // The new child is the only one whose reach was never computed
+        if(position + 1 <= half)
+            refreshChild(node, position + 1, level == index->height - 1);
         else
-            node = node->right;
+            refreshChild(sibling, position - half, level == index->height - 1);
+
+        key = keys[half];
+        child = sibling;
+        level--;
     }
 
-    return node;
+    // The root was split, a new root is needed
+    COUNT(rootSplits, 1);
+    node = createInnerNode(index);
+    node->numberOfKeys = 1;
+    node->keys[0] = key;
+    node->children[0] = index->root;
+    node->children[1] = child;
+    refreshChild(node, 0, index->height == 0);
+    refreshChild(node, 1, index->height == 0);
+    index->root = node;
+    index->height++;
 }
 
-void fixDelete(pStation* root, pStation node, pStation parent) {
-    pStation sibling;
+int removeStation(pStationIndex index, unsigned int stationID) {
+    TreePath path;
+    pLeaf leaf;
+    unsigned int forwardReach;
+    int backwardReach;
+    int slot;
 
-    while ((node == NULL || node->color == BLACK) && node != *root) {
-        if (node == parent->left) {
-            sibling = parent->right;
+    if(index->root == NULL)
+        return 0;
 
-            if (sibling->color == RED) {
-                sibling->color = BLACK;
-                parent->color = RED;
-                leftRotate(root, parent);
-                sibling = parent->right;
-            }
+    leaf = findLeaf(index, stationID, &path);
+    slot = findSlot(leaf, stationID);
+    if(slot == leaf->numberOfStations || leaf->stations[slot].stationID != stationID)// If the station with the given ID is not found, return
+        return 0;
 
-            if ((sibling->left == NULL || sibling->left->color == BLACK) &&
-                (sibling->right == NULL || sibling->right->color == BLACK)) {
-                sibling->color = RED;
-                node = parent;
-                parent = node->parent;
-            } else {
-                if (sibling->right == NULL || sibling->right->color == BLACK) {
-                    sibling->left->color = BLACK;
-                    sibling->color = RED;
-                    rightRotate(root, sibling);
-                    sibling = parent->right;
-                }
+    leaf = writableLeaf(index, &path);
+    forwardReach = leaf->stations[slot].forwardReach;
+    backwardReach = leaf->stations[slot].backwardReach;
+    freeMaxHeap(index, leaf->stations[slot].cars);
+    leaf->numberOfStations--;
+    memmove(&leaf->stations[slot], &leaf->stations[slot + 1], (leaf->numberOfStations - slot) * sizeof(Station));
+    index->numberOfStations--;
+    shrinkReach(index, &path, forwardReach, backwardReach); //rebalancing moves stations between siblings, it does not change the reach of their parent
+    invalidateRoutes(index->routes, stationID);
+
+    if(index->height > 0 && leaf->numberOfStations < LEAF_SIZE / 2)// The root leaf is allowed to be almost empty
+        rebalanceLeaf(index, leaf, &path);
+    return 1;
+}
 
-                sibling->color = parent->color;
-                parent->color = BLACK;
-                sibling->right->color = BLACK;
-                leftRotate(root, parent);
-                node = *root;
-                break;
-            }
+void rebalanceLeaf(pStationIndex index, pLeaf leaf, TreePath* path) {
+    pInnerNode parent = path->nodes[index->height - 1];
+    int position = path->childIndex[index->height - 1];
+    pLeaf left = position > 0 ? (pLeaf) parent->children[position - 1] : NULL;
+    pLeaf right = position < parent->numberOfKeys ? (pLeaf) parent->children[position + 1] : NULL;
+    pLeaf removed;
+
+    if(left != NULL && left->numberOfStations > LEAF_SIZE / 2) {// Borrow the last station of the left sibling
+        left = (pLeaf) ownNode(index, &parent->children[position - 1], 1);
+        memmove(&leaf->stations[1], &leaf->stations[0], leaf->numberOfStations * sizeof(Station));
+        leaf->stations[0] = left->stations[--left->numberOfStations];
+        leaf->numberOfStations++;
+        parent->keys[position - 1] = leaf->stations[0].stationID;
+        refreshChild(parent, position - 1, 1);
+        refreshChild(parent, position, 1);
+        COUNT(leafBorrows, 1);
+        return;
+    }
+    if(right != NULL && right->numberOfStations > LEAF_SIZE / 2) {// Borrow the first station of the right sibling
+        right = (pLeaf) ownNode(index, &parent->children[position + 1], 1);
+        leaf->stations[leaf->numberOfStations++] = right->stations[0];
+        right->numberOfStations--;
+        memmove(&right->stations[0], &right->stations[1], right->numberOfStations * sizeof(Station));
+        parent->keys[position] = right->stations[0].stationID;
+        refreshChild(parent, position, 1);
+        refreshChild(parent, position + 1, 1);
+        COUNT(leafBorrows, 1);
+        return;
+    }
+
+    // Both siblings are at most half full, the leaf is merged with one of them
+    if(left != NULL) {
+        removed = leaf;
+        leaf = (pLeaf) ownNode(index, &parent->children[position - 1], 1);
+    } else {
+        removed = right;
+        position++;
+    }
+    memcpy(&leaf->stations[leaf->numberOfStations], removed->stations, removed->numberOfStations * sizeof(Station));
+    leaf->numberOfStations += removed->numberOfStations;
+    dropNode(index, removed, 1);
+    COUNT(leafMerges, 1);
+
+    removeChild(parent, position);
+    refreshChild(parent, position - 1, 1);
+    rebalanceInner(index, path, index->height - 1);
+}
+
+void rebalanceInner(pStationIndex index, TreePath* path, int level) {
+    pInnerNode node;
+    pInnerNode parent;
+    pInnerNode left;
+    pInnerNode right;
+    pInnerNode removed;
+    int position;
+
+    for(; level > 0; level--) {
+        node = path->nodes[level];
+        if(node->numberOfKeys >= INNER_SIZE / 2)
+            return;
+
+        parent = path->nodes[level - 1];
+        position = path->childIndex[level - 1];
+        left = position > 0 ? (pInnerNode) parent->children[position - 1] : NULL;
+        right = position < parent->numberOfKeys ? (pInnerNode) parent->children[position + 1] : NULL;
+
+        if(left != NULL && left->numberOfKeys > INNER_SIZE / 2) {// Rotate the last child of the left sibling through the parent
+            left = (pInnerNode) ownNode(index, &parent->children[position - 1], 0);
+            memmove(&node->keys[1], &node->keys[0], node->numberOfKeys * sizeof(unsigned int));
+            memmove(&node->children[1], &node->children[0], (node->numberOfKeys + 1) * sizeof(void*));
+            memmove(&node->forwardReach[1], &node->forwardReach[0], (node->numberOfKeys + 1) * sizeof(unsigned int));
+            memmove(&node->backwardReach[1], &node->backwardReach[0], (node->numberOfKeys + 1) * sizeof(int));
+            node->keys[0] = parent->keys[position - 1];
+            node->children[0] = left->children[left->numberOfKeys];
+            node->forwardReach[0] = left->forwardReach[left->numberOfKeys];
+            node->backwardReach[0] = left->backwardReach[left->numberOfKeys];
+            node->numberOfKeys++;
+            parent->keys[position - 1] = left->keys[--left->numberOfKeys];
+            refreshChild(parent, position - 1, 0);
+            refreshChild(parent, position, 0);
+            COUNT(innerBorrows, 1);
+            return;
+        }
+        if(right != NULL && right->numberOfKeys > INNER_SIZE / 2) {// Rotate the first child of the right sibling through the parent
+            right = (pInnerNode) ownNode(index, &parent->children[position + 1], 0);
+            node->keys[node->numberOfKeys] = parent->keys[position];
+            node->children[node->numberOfKeys + 1] = right->children[0];
+            node->forwardReach[node->numberOfKeys + 1] = right->forwardReach[0];
+            node->backwardReach[node->numberOfKeys + 1] = right->backwardReach[0];
+            node->numberOfKeys++;
+            parent->keys[position] = right->keys[0];
+            right->numberOfKeys--;
+            memmove(&right->keys[0], &right->keys[1], right->numberOfKeys * sizeof(unsigned int));
+            memmove(&right->children[0], &right->children[1], (right->numberOfKeys + 1) * sizeof(void*));
+            memmove(&right->forwardReach[0], &right->forwardReach[1], (right->numberOfKeys + 1) * sizeof(unsigned int));
+            memmove(&right->backwardReach[0], &right->backwardReach[1], (right->numberOfKeys + 1) * sizeof(int));
+            refreshChild(parent, position, 0);
+            refreshChild(parent, position + 1, 0);
+            COUNT(innerBorrows, 1);
+            return;
+        }
+
+        // Both siblings are at most half full, the node is merged with one of them and the separator comes down
+        if(left != NULL) {
+            removed = node;
+            node = (pInnerNode) ownNode(index, &parent->children[position - 1], 0);
         } else {
-            sibling = parent->left;
+            removed = right;
+            position++;
+        }
+        node->keys[node->numberOfKeys] = parent->keys[position - 1];
+        memcpy(&node->keys[node->numberOfKeys + 1], removed->keys, removed->numberOfKeys * sizeof(unsigned int));
+        memcpy(&node->children[node->numberOfKeys + 1], removed->children, (removed->numberOfKeys + 1) * sizeof(void*));
+        memcpy(&node->forwardReach[node->numberOfKeys + 1], removed->forwardReach, (removed->numberOfKeys + 1) * sizeof(unsigned int));
+        memcpy(&node->backwardReach[node->numberOfKeys + 1], removed->backwardReach, (removed->numberOfKeys + 1) * sizeof(int));
+        node->numberOfKeys += removed->numberOfKeys + 1;
+        dropNode(index, removed, 0);
+        COUNT(innerMerges, 1);
+
+        removeChild(parent, position);
+        refreshChild(parent, position - 1, 0);
+    }
 
-            if (sibling->color == RED) {
-                sibling->color = BLACK;
-                parent->color = RED;
-                rightRotate(root, parent);
-                sibling = parent->left;
-            }
+    node = path->nodes[0];
+    if(node->numberOfKeys == 0) {// The root is left with a single child that becomes the new root
+        index->root = node->children[0];
+        index->height--;
+        dropNode(index, node, 0);
+        COUNT(rootCollapses, 1);
+    }
+}
 
-            if ((sibling->left == NULL || sibling->left->color == BLACK) &&
-                (sibling->right == NULL || sibling->right->color == BLACK)) {
-                sibling->color = RED;
-                node = parent;
-                parent = node->parent;
-            } else {
-                if (sibling->left == NULL || sibling->left->color == BLACK) {
-                    sibling->right->color = BLACK;
-                    sibling->color = RED;
-                    leftRotate(root, sibling);
-                    sibling = parent->left;
-                }
+void removeChild(pInnerNode node, int position) {
+    int moved = node->numberOfKeys - position;
 
-                sibling->color = parent->color;
-                parent->color = BLACK;
-                sibling->left->color = BLACK;
-                rightRotate(root, parent);
-                node = *root;
-                break;
+    memmove(&node->keys[position - 1], &node->keys[position], moved * sizeof(unsigned int));
+    memmove(&node->children[position], &node->children[position + 1], moved * sizeof(void*));
+    memmove(&node->forwardReach[position], &node->forwardReach[position + 1], moved * sizeof(unsigned int));
+    memmove(&node->backwardReach[position], &node->backwardReach[position + 1], moved * sizeof(int));
+    node->numberOfKeys--;
+}
+
+void initStationIndex(pStationIndex index, RouteCache* routes) {
+    memset(index, 0, sizeof(StationIndex));
+    index->version = FIRST_VERSION;
+    index->routes = routes;
+    index->leafPool = (Pool) {.name = "leaves", .objectSize = (sizeof(Leaf) + 7) & ~(size_t) 7};
+    index->innerPool = (Pool) {.name = "inner nodes", .objectSize = (sizeof(InnerNode) + 7) & ~(size_t) 7};
+    index->carsPool = (Pool) {.name = "cars", .objectSize = (sizeof(MaxHeap) + 7) & ~(size_t) 7};
+}
+
+void freeStationIndex(pStationIndex index) {
+    int i;
+
+    if(index->root != NULL)
+        freeIndexNode(index, index->root, index->height);
+    index->root = NULL;
+    index->height = 0;
+    // No reader is left, the older versions are released too
+    for(i = 0; i < index->numberOfRetired; i++) {
+        if(index->retired[i].pool != NULL)
+            poolFree(index->retired[i].pool, index->retired[i].object);
+        else
+            free(index->retired[i].object);
+    }
+    free(index->retired);
+    index->retired = NULL;
+    index->numberOfRetired = index->retiredCapacity = 0;
+    free(index->published);
+    index->published = NULL;
+    index->numberOfStations = 0;
+    index->writeLeaf = NULL;
+}
+
+void freeIndexNode(pStationIndex index, void* node, int level) {
+    pInnerNode inner;
+    pLeaf leaf;
+    int i;
+
+    if(level == 0) {
+        leaf = (pLeaf) node;
+        for(i = 0; i < leaf->numberOfStations; i++)
+            freeMaxHeap(index, leaf->stations[i].cars);
+        poolFree(&index->leafPool, leaf);
+        return;
+    }
+    inner = (pInnerNode) node;
+    for(i = 0; i <= inner->numberOfKeys; i++)
+        freeIndexNode(index, inner->children[i], level - 1);
+    poolFree(&index->innerPool, inner);
+}
+
+void buildInnerNodes(pStationIndex index, void** children, unsigned int* keys, int numberOfChildren) {
+    pInnerNode node;
+    int numberOfNodes;
+    int taken;
+    int size;
+    int i, j;
+
+    index->height = 0;
+    while(numberOfChildren > 1) {
+        // As few nodes as possible, with the children spread evenly so that every node is at least half full
+        numberOfNodes = (numberOfChildren + INNER_SIZE) / (INNER_SIZE + 1);
+        taken = 0;
+        for(i = 0; i < numberOfNodes; i++) {
+            size = numberOfChildren / numberOfNodes + (i < numberOfChildren % numberOfNodes);
+            node = createInnerNode(index);
+            node->numberOfKeys = size - 1;
+            node->children[0] = children[taken];
+            for(j = 1; j < size; j++) {
+                node->keys[j - 1] = keys[taken + j];
+                node->children[j] = children[taken + j];
             }
+            for(j = 0; j < size; j++)
+                refreshChild(node, j, index->height == 0);
+            // The nodes of the level replace their children at the beginning of the arrays, which were already read
+            keys[i] = keys[taken];
+            children[i] = node;
+            taken += size;
         }
+        numberOfChildren = numberOfNodes;
+        index->height++;
     }
+    index->root = children[0];
+}
+
+int saveSnapshot(pStationIndex index, const char* path) {
+    FILE* file = fopen(path, "wb");
+    uint32_t header[2] = {index->numberOfStations, 0};
+    uint32_t fields[2];
+    StationCursor cursor;
+    pStation station;
 
-    if (node != NULL)
-        node->color = BLACK;
+    if(file == NULL)
+        return 0;
+    fwrite(SNAPSHOT_MAGIC, 1, 8, file);
+    fwrite(header, sizeof(uint32_t), 2, file);
+    for(station = seekStation(index, 0, &cursor); station != NULL; station = nextStation(&cursor)) {
+        fields[0] = station->stationID;
+        fields[1] = (uint32_t) station->cars->numOfCars;
+        fwrite(fields, sizeof(uint32_t), 2, file);
+        fwrite(station->cars->array, sizeof(uint32_t), station->cars->numOfCars, file);
+    }
+    return !ferror(file) & (fclose(file) == 0);
 }
 
-int removeStation(pStation* root, unsigned int stationID) {
-    pStation node = *root;
-    pStation temp;
-    pStation successor;
-    int i;
+int loadSnapshot(pStationIndex index, const char* path) {
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    const uint32_t* words;
+    size_t numberOfWords;
+    size_t position;
+    uint32_t count;
+    uint32_t previousID = 0;
+    uint32_t stations;
+    uint32_t i, j;
+    void** leaves;
+    unsigned int* keys;
+    int numberOfLeaves;
+    int leafNumber = 0;
+    pLeaf leaf = NULL;
+    pStation station;
+    pMaxHeap cars;
+    void* mapped;
 
-    while (node != NULL) {// Search for the station with the given pair1
-        if (stationID == node->stationID)
+    if(fd < 0)
+        return 0;
+    if(fstat(fd, &info) != 0 || info.st_size < 16 || info.st_size % sizeof(uint32_t) != 0) {
+        close(fd);
+        return 0;
+    }
+    mapped = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED)
+        return 0;
+    madvise(mapped, (size_t) info.st_size, MADV_SEQUENTIAL);
+    words = (const uint32_t*) mapped;
+    numberOfWords = (size_t) info.st_size / sizeof(uint32_t);
+    stations = words[2];
+
+    // The whole file is checked before building anything: sizes, stations in increasing order and heaps
+    position = 4;
+    for(i = 0; i < stations; i++) {
+        if(numberOfWords - position < 2 || (i > 0 && words[position] <= previousID))
             break;
-
-        if (stationID < node->stationID)
-            node = node->left;
-        else
-            node = node->right;
+        previousID = words[position];
+        count = words[position + 1];
+        if(numberOfWords - position - 2 < count)
+            break;
+        for(j = 1; j < count && words[position + 2 + (j - 1) / 2] >= words[position + 2 + j]; j++);
+        if(j < count)
+            break;
+        position += 2 + count;
     }
-
-    if (node == NULL)// If the station with the given pair1 is not found, return
+    if(memcmp(mapped, SNAPSHOT_MAGIC, 8) != 0 || i < stations || position != numberOfWords || index->root != NULL) {
+        munmap(mapped, (size_t) info.st_size);
         return 0;
-
-    if (node->left == NULL || node->right == NULL)// If the station has only one child
-        successor = node;
-    else {// If the station has two children
-        successor = node->right;
-
-        while (successor->left != NULL)
-            successor = successor->left;
     }
-
-    if (successor->left != NULL)// If the successor has a left child
-        temp = successor->left;
-    else // If the successor has no left child
-        temp = successor->right;
-
-    if (temp != NULL)// Set the parent of the successor's child
-        temp->parent = successor->parent;
-
-    if (successor->parent == NULL)// If the successor is the root
-        *root = temp;
-    else if (successor == successor->parent->left)// If the successor is a left child
-        successor->parent->left = temp;
-    else// If the successor is a right child
-        successor->parent->right = temp;
-
-    if (successor != node) {
-        node->stationID = successor->stationID;
-        node->cars->numOfCars = successor->cars->numOfCars;
-        for(i = 0; i < node->cars->numOfCars; i++)
-            node->cars->array[i] = successor->cars->array[i];
+    if(stations == 0) {
+        munmap(mapped, (size_t) info.st_size);
+        return 1;
     }
 
-    if (successor->color == BLACK)// If the successor is black, fix the tree
-        fixDelete(root, temp, successor->parent);
-
+    // The stations are spread evenly over as few leaves as possible, so that every leaf is at least half full
+    numberOfLeaves = (int) ((stations + LEAF_SIZE - 1) / LEAF_SIZE);
+    leaves = (void**) malloc(numberOfLeaves * sizeof(void*));
+    keys = (unsigned int*) malloc(numberOfLeaves * sizeof(unsigned int));
+    if(leaves == NULL || keys == NULL)
+        exit(7);
+    position = 4;
+    for(i = 0; i < stations; i++) {
+        if(leaf == NULL || leaf->numberOfStations == (int) (stations / numberOfLeaves) + (leafNumber <= (int) (stations % numberOfLeaves))) {
+            leaf = createLeaf(index);
+            keys[leafNumber] = words[position];
+            leaves[leafNumber++] = leaf;
+        }
+        count = words[position + 1];
+        cars = createMaxHeap(index);
+        if(count > (uint32_t) cars->capacity) {
+            cars->array = allocateCars((int) count);
+            cars->capacity = (int) count;
+        }
+        memcpy(cars->array, &words[position + 2], count * sizeof(unsigned int));
+        cars->numOfCars = (int) count;
+        if(cars->capacity > INDEXED_CARS)
+            buildCarIndex(cars);
+
+        station = &leaf->stations[leaf->numberOfStations++];
+        station->stationID = words[position];
+        station->forwardReach = station->stationID;
+        station->backwardReach = (int) station->stationID;
+        station->cars = cars;
+        updateReach(index, station);
+        position += 2 + count;
+    }
+    munmap(mapped, (size_t) info.st_size);
 
-    free(successor->cars);
-    free(successor);
-    numberOfStations--;
+    index->numberOfStations = stations;
+    buildInnerNodes(index, leaves, keys, numberOfLeaves);
+    free(leaves);
+    free(keys);
+    clearRouteCache(index->routes); //the stations without cars did not invalidate the routes
     return 1;
 }
 
-pStation addStation(pStation* root, unsigned int stationID) {// Function to addStation a station into the Red-Black Tree
-    pStation newNode = createNode(stationID);
+pLeaf createLeaf(pStationIndex index) {
+    pLeaf leaf = (pLeaf) poolAlloc(&index->leafPool);
+    leaf->version = index->version;
+    leaf->numberOfStations = 0;
+    return leaf;
+}
 
-    pStation y = NULL;
-    pStation x = *root;
+pInnerNode createInnerNode(pStationIndex index) {
+    pInnerNode node = (pInnerNode) poolAlloc(&index->innerPool);
+    node->version = index->version;
+    return node;
+}
 
-    while (x != NULL) {// Search for the station with the given pair1
-        y = x;
-        if(stationID == x->stationID) {//WARNING: This is not specified in the assignment you may need to add the cars to the station
-            return NULL;
-        } else if (stationID < x->stationID) {
-            x = x->left;
-        } else {
-            x = x->right;
-        }
+void* ownNode(pStationIndex index, void** link, int isLeaf) {
+    pLeaf leaf;
+    pInnerNode node;
+
+    if(isLeaf) {
+        leaf = (pLeaf) *link;
+        if(leaf->version == index->version)
+            return leaf;
+        // Only the stations in use are copied
+        *link = createLeaf(index);
+        memcpy(*link, leaf, offsetof(Leaf, stations) + leaf->numberOfStations * sizeof(Station));
+        ((pLeaf) *link)->version = index->version;
+        retireObject(index, leaf, &index->leafPool);
+    } else {
+        node = (pInnerNode) *link;
+        if(node->version == index->version)
+            return node;
+        *link = createInnerNode(index);
+        memcpy(*link, node, sizeof(InnerNode));
+        ((pInnerNode) *link)->version = index->version;
+        retireObject(index, node, &index->innerPool);
     }
+    return *link;
+}
 
-    newNode->parent = y;
+pLeaf writableLeaf(pStationIndex index, TreePath* path) {
+    void** link = &index->root;
+    int level;
 
-    if (y == NULL) {// If the tree is empty
-        *root = newNode;
-    } else if (stationID < y->stationID) {// If the station is a left child
-        y->left = newNode;
-    } else {// If the station is a right child
-        y->right = newNode;
+    for(level = 0; level < index->height; level++) {
+        path->nodes[level] = (pInnerNode) ownNode(index, link, 0);
+        link = &path->nodes[level]->children[path->childIndex[level]];
+        index->writePath.nodes[level] = path->nodes[level];
+        index->writePath.childIndex[level] = path->childIndex[level];
     }
-
-    insertFix(root, newNode);// Fix the tree
-    numberOfStations++;
-    return newNode;
+    index->writeLeaf = (pLeaf) ownNode(index, link, 1);
+    return index->writeLeaf;
 }
 
-void insertFix(pStation* root, pStation node) {// Function to fix the Red-Black Tree after insertion
-    while (node != *root && node->parent->color == RED) {// While the parent of the station is red
-        if (node->parent == node->parent->parent->left) {// If the parent of the station is a left child
-            pStation uncle = node->parent->parent->right;
-
-            if (uncle != NULL && uncle->color == RED) {// If the uncle of the station is red
-                node->parent->color = BLACK;
-                uncle->color = BLACK;
-                node->parent->parent->color = RED;
-                node = node->parent->parent;
-            } else {// If the uncle of the station is black
-                if (node == node->parent->right) {
-                    node = node->parent;
-                    leftRotate(root, node);
-                }
-
-                node->parent->color = BLACK;
-                node->parent->parent->color = RED;
-                rightRotate(root, node->parent->parent); // Right rotate the tree
-            }
-        } else {// If the parent of the station is a right child
-            pStation uncle = node->parent->parent->left;
-
-            if (uncle != NULL && uncle->color == RED) {// If the uncle of the station is red
-                node->parent->color = BLACK;
-                uncle->color = BLACK;
-                node->parent->parent->color = RED;
-                node = node->parent->parent;
-            } else {// If the uncle of the station is black
-                if (node == node->parent->left) {
-                    node = node->parent;
-                    rightRotate(root, node);
-                }
+pStation writableStation(pStationIndex index, unsigned int stationID) {
+    TreePath path;
+    pLeaf leaf;
+    int slot;
 
-                node->parent->color = BLACK;
-                node->parent->parent->color = RED;
-                leftRotate(root, node->parent->parent);// Left rotate the tree
-            }
-        }
-    }
+    if(index->root == NULL)
+        return NULL;
 
-    (*root)->color = BLACK;
+    leaf = findLeaf(index, stationID, &path);
+    slot = findSlot(leaf, stationID);
+    if(slot == leaf->numberOfStations || leaf->stations[slot].stationID != stationID)
+        return NULL;
+    leaf = writableLeaf(index, &path);
+    return &leaf->stations[slot];
 }
 
-void leftRotate(pStation* root, pStation node) {// Function to left rotate the Red-Black Tree
-
-    pStation rightChild = node->right;
-    node->right = rightChild->left;
+void dropNode(pStationIndex index, void* node, int isLeaf) {
+    unsigned long version = isLeaf ? ((pLeaf) node)->version : ((pInnerNode) node)->version;
 
-    if (rightChild->left != NULL) {
-        rightChild->left->parent = node;
-    }
+    if(node == index->writeLeaf)
+        index->writeLeaf = NULL;
+    if(version == index->version)// No published version can reach the node
+        poolFree(isLeaf ? &index->leafPool : &index->innerPool, node);
+    else
+        retireObject(index, node, isLeaf ? &index->leafPool : &index->innerPool);
+}
 
-    rightChild->parent = node->parent;
+void retireObject(pStationIndex index, void* object, Pool* pool) {
+    RetiredObject* retired;
 
-    if (node->parent == NULL) {
-        *root = rightChild;
-    } else if (node == node->parent->left) {
-        node->parent->left = rightChild;
-    } else {
-        node->parent->right = rightChild;
+    if(index->numberOfRetired == index->retiredCapacity) {
+        retired = (RetiredObject*) realloc(index->retired, (index->retiredCapacity * 2 + 64) * sizeof(RetiredObject));
+        if(retired == NULL) {
+            exit(7);
+        }
+        index->retired = retired;
+        index->retiredCapacity = index->retiredCapacity * 2 + 64;
     }
-
-    rightChild->left = node;
-    node->parent = rightChild;
+    index->retired[index->numberOfRetired].object = object;
+    index->retired[index->numberOfRetired].pool = pool;
+    index->retired[index->numberOfRetired].version = index->version;
+    index->numberOfRetired++;
 }
 
-void rightRotate(pStation* root, pStation node) {// Function to right rotate the Red-Black Tree
+void publishIndex(pStationIndex index) {
+    IndexVersion* version;
 
-    pStation leftChild = node->left;
-    node->left = leftChild->right;
+    // The root is copied by any change, if it is the published one nothing changed
+    if(index->published != NULL && index->published->root == index->root)
+        return;
 
-    if (leftChild->right != NULL) {
-        leftChild->right->parent = node;
+    version = (IndexVersion*) malloc(sizeof(IndexVersion));
+    if(version == NULL) {
+        exit(7);
     }
+    version->root = index->root;
+    version->height = index->height;
+    version->version = index->version;
+    if(index->published != NULL)
+        retireObject(index, index->published, NULL);
+    __atomic_store_n(&index->published, version, __ATOMIC_SEQ_CST);
+    index->version++; // From now on the nodes of the published version are copied before being changed
+}
 
-    leftChild->parent = node->parent;
-
-    if (node->parent == NULL) {
-        *root = leftChild;
-    } else if (node == node->parent->right) {
-        node->parent->right = leftChild;
-    } else {
-        node->parent->left = leftChild;
-    }
+void pinIndex(pStationIndex index, int reader, StationIndex* view) {
+    IndexVersion* version;
 
-    leftChild->right = node;
-    node->parent = leftChild;
+    // While the reader is marked with 1 the writer does not release anything, so the version read stays valid
+    __atomic_store_n(&index->readers[reader], 1, __ATOMIC_SEQ_CST);
+    version = __atomic_load_n(&index->published, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&index->readers[reader], version->version, __ATOMIC_SEQ_CST);
+    view->root = version->root;
+    view->height = version->height;
+    view->version = version->version;
 }
 
-pStation createNode(unsigned int stationID) {
+void unpinIndex(pStationIndex index, int reader) {
+    __atomic_store_n(&index->readers[reader], 0, __ATOMIC_RELEASE);
+}
 
-    pStation newNode = (pStation) malloc(sizeof(Station));
-    newNode->stationID = stationID;
-    newNode->cars = createMaxHeap();
-    newNode->parent = newNode->left = newNode->right = NULL;
-    newNode->color = RED;
+void reclaimRetired(pStationIndex index) {
+    unsigned long oldest;
+    unsigned long held;
+    int released;
+    int i;
 
-    return  newNode;
-}
+    if(index->published == NULL || index->numberOfRetired == 0)
+        return;
 
-int removeCar(MaxHeap* maxHeap, unsigned int carID) {
-    // Check if the heap is empty
-    if (maxHeap->numOfCars == 0) {
-        return 0;
+    // An object retired in version v is reachable only from older versions, it is released once every reader holds v or a newer one
+    oldest = index->published->version;
+    for(i = 0; i < MAX_READERS; i++) {
+        held = __atomic_load_n(&index->readers[i], __ATOMIC_SEQ_CST);
+        if(held != 0 && held < oldest)
+            oldest = held;
+    }
+    for(released = 0; released < index->numberOfRetired && index->retired[released].version <= oldest; released++) {
+        if(index->retired[released].pool != NULL)
+            poolFree(index->retired[released].pool, index->retired[released].object);
+        else
+            free(index->retired[released].object);
     }
+    memmove(index->retired, &index->retired[released], (index->numberOfRetired - released) * sizeof(RetiredObject));
+    index->numberOfRetired -= released;
+}
 
-    // Find the element in the heap
+int removeCar(pStationIndex index, pStation station, unsigned int carID) {
+    pMaxHeap maxHeap = station->cars;
     int i;
-    for (i = 0; i < maxHeap->numOfCars; i++) {
-        if (maxHeap->array[i] == carID) {
-            break;
-        }
-    }
 
-    // If the element is not found, return 0
-    if (i == maxHeap->numOfCars) {
+    COUNT(carScans, 1);
+    // Find the element in the heap
+    i = findCar(maxHeap, carID);
+    if (i < 0) {
         return 0;
     }
 
-    // Swap the found element with the last element in the heap
-    maxHeap->array[i] = maxHeap->array[maxHeap->numOfCars - 1];
+    // Replace the found element with the last element in the heap
+    if (maxHeap->capacity > INDEXED_CARS)
+        unindexCar(maxHeap, i);
+    if (i != maxHeap->numOfCars - 1)
+        moveCar(maxHeap, maxHeap->numOfCars - 1, i);
 
     // Decrease the size of the heap
     maxHeap->numOfCars--;
 
-    // Heapify the root element
+    // The moved element may be larger than its new parent, otherwise it is pushed down
+    while (i != 0 && i < maxHeap->numOfCars && maxHeap->array[(i - 1) / 2] < maxHeap->array[i]) {
+        swapCars(maxHeap, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+        COUNT(siftUpSteps, 1);
+    }
     restoreHeapProperty(maxHeap, i);
+    updateReach(index, station);
 
     // Return 1 indicating success
     return 1;
@@ -1057,7 +4007,7 @@ int removeCar(MaxHeap* maxHeap, unsigned int carID) {
 void restoreHeapProperty(MaxHeap* maxHeap, int idx) {
     int largest;
 
-    do {
+    for (;;) {
         int left = (idx * 2) + 1;
         int right = (idx + 1) * 2;
 
@@ -1071,91 +4021,334 @@ void restoreHeapProperty(MaxHeap* maxHeap, int idx) {
         if (right < maxHeap->numOfCars && maxHeap->array[right] > maxHeap->array[largest])
             largest = right;
 
-        // If largest is not root
-        if (largest != idx) {
-            // Swap
-            unsigned int temp = maxHeap->array[largest];
-            maxHeap->array[largest] = maxHeap->array[idx];
-            maxHeap->array[idx] = temp;
+        // If largest is root the heap property holds
+        if (largest == idx)
+            break;
 
-            // Move to the next node
-            idx = largest;
-        }
-    } while (largest != idx);
+        // Swap
+        swapCars(maxHeap, largest, idx);
+
+        // Move to the next node
+        idx = largest;
+        COUNT(siftDownSteps, 1);
+    }
 }
 
-void addCar(pMaxHeap maxHeap, unsigned int carID) {
-    if(maxHeap->numOfCars == MAX_SIZE_CARS) {
-        exit(6);
+void addCar(pStationIndex index, pStation station, unsigned int carID) {
+    pMaxHeap maxHeap = station->cars;
+
+    if(maxHeap->numOfCars == maxHeap->capacity) {
+        growMaxHeap(maxHeap);
     }
     // First insertLinked the new number at the end
     int i = maxHeap->numOfCars;
     maxHeap->array[i] = carID;
     maxHeap->numOfCars++;
+    if (maxHeap->capacity > INDEXED_CARS)
+        indexCar(maxHeap, i);
 
     // Fix the max heap property if it is violated
     while (i != 0 && maxHeap->array[(i - 1) / 2] < maxHeap->array[i]) {
-        unsigned int temp = maxHeap->array[i];
-        maxHeap->array[i] = maxHeap->array[(i - 1) / 2];
-        maxHeap->array[(i - 1) / 2] = temp;
+        swapCars(maxHeap, i, (i - 1) / 2);
         i = (i - 1) / 2;
+        COUNT(siftUpSteps, 1);
     }
+    updateReach(index, station);
 }
 
-pMaxHeap createMaxHeap() {
-    pMaxHeap heap = (pMaxHeap) malloc(sizeof(MaxHeap));
+void updateReach(pStationIndex index, pStation station) {
+    unsigned int maxRange = station->cars->numOfCars > 0 ? station->cars->array[0] : 0;
+    unsigned int forwardReach = station->forwardReach;
+    int backwardReach = station->backwardReach;
+    TreePath path;
+    pLeaf leaf;
+
+    if(station->forwardReach == station->stationID + maxRange)// The routes depend only on the reach, they are still valid
+        return;
+    station->forwardReach = station->stationID + maxRange;
+    station->backwardReach = (int) station->stationID - (int) maxRange;
+    // Stations loaded in bulk get their reach in the inner nodes once these are built
+    if(index->height > 0 && index->root != NULL) {
+        leaf = index->writeLeaf; //the cars are changed right after the station was made writable
+        if(leaf == NULL || leaf->numberOfStations == 0 || station->stationID < leaf->stations[0].stationID ||
+           station->stationID > leaf->stations[leaf->numberOfStations - 1].stationID) {
+            findLeaf(index, station->stationID, &path);
+            leaf = writableLeaf(index, &path);
+        }
+        if(station->forwardReach > forwardReach)
+            extendReach(index, &index->writePath, station->forwardReach, station->backwardReach);
+        else
+            shrinkReach(index, &index->writePath, forwardReach, backwardReach);
+    }
+    invalidateRoutes(index->routes, station->stationID);
+}
+
+pMaxHeap createMaxHeap(pStationIndex index) {
+    pMaxHeap heap = (pMaxHeap) poolAlloc(&index->carsPool);
     heap->numOfCars = 0;
+    heap->capacity = INLINE_CARS;
+    heap->array = heap->inlineCars;
     return heap;
 }
 
-void freeQueue(pQueue queue) {
-    pEntry temp;
-    if(queue == NULL)
-        return;
-    while((temp = dequeue(queue)) != NULL) {
-        free(temp);
+void growMaxHeap(pMaxHeap maxHeap) {
+    unsigned int* array = allocateCars(2 * maxHeap->capacity);
+
+    // The hash table depends on the capacity, it is built again in the new block
+    memcpy(array, maxHeap->array, maxHeap->numOfCars * sizeof(unsigned int));
+    if(maxHeap->array != maxHeap->inlineCars)
+        free(maxHeap->array);
+    maxHeap->array = array;
+    maxHeap->capacity *= 2;
+    if(maxHeap->capacity > INDEXED_CARS)
+        buildCarIndex(maxHeap);
+}
+
+unsigned int* allocateCars(int capacity) {
+    int bits = carIndexBits(capacity);
+    size_t words = (size_t) capacity;
+    unsigned int* array;
+
+    if(bits > 0)
+        words += (size_t) capacity + ((size_t) 1 << bits);
+    array = (unsigned int*) malloc(words * sizeof(unsigned int));
+    if(array == NULL) {
+        exit(6);
     }
-    free(queue);
+    return array;
 }
 
-pEntry dequeue(pQueue queue) {
-    if(queue->head == NULL)
-        return NULL;
+int carIndexBits(int capacity) {
+    if(capacity <= INDEXED_CARS)
+        return 0;
+    // At least twice as many buckets as cars keeps the probe sequences short
+    return 32 - __builtin_clz((unsigned int) (2 * capacity - 1));
+}
 
-    Entry* temp = queue->head;
+unsigned int carBucket(unsigned int carID, int bits) {
+    return (carID * 2654435761u) >> (32 - bits);
+}
 
-    queue->head = queue->head->next;
+void buildCarIndex(pMaxHeap maxHeap) {
+    int* table = (int*) (maxHeap->array + 2 * maxHeap->capacity);
+    int i;
 
-    if(queue->head == NULL)
-        queue->tail = NULL;
+    memset(table, 0xff, ((size_t) 1 << carIndexBits(maxHeap->capacity)) * sizeof(int)); //every bucket becomes EMPTY_BUCKET
+    for(i = 0; i < maxHeap->numOfCars; i++)
+        indexCar(maxHeap, i);
+}
 
-    return temp;
+void indexCar(pMaxHeap maxHeap, int slot) {
+    int bits = carIndexBits(maxHeap->capacity);
+    unsigned int mask = (1u << bits) - 1;
+    int* positions = (int*) (maxHeap->array + maxHeap->capacity);
+    int* table = positions + maxHeap->capacity;
+    unsigned int bucket = carBucket(maxHeap->array[slot], bits);
+
+    while(table[bucket] != EMPTY_BUCKET)
+        bucket = (bucket + 1) & mask;
+    table[bucket] = slot;
+    positions[slot] = (int) bucket;
 }
 
-void enqueue(pQueue queue, int maxRange, int stationIndex) {
-    pEntry entry = (pEntry) malloc(sizeof(Entry));
-    if(maxRange < 0)
-        maxRange = 0;
+void unindexCar(pMaxHeap maxHeap, int slot) {
+    int bits = carIndexBits(maxHeap->capacity);
+    unsigned int mask = (1u << bits) - 1;
+    int* positions = (int*) (maxHeap->array + maxHeap->capacity);
+    int* table = positions + maxHeap->capacity;
+    unsigned int hole = (unsigned int) positions[slot];
+    unsigned int bucket = hole;
+    unsigned int home;
+
+    table[hole] = EMPTY_BUCKET;
+    for(;;) {
+        bucket = (bucket + 1) & mask;
+        if(table[bucket] == EMPTY_BUCKET)
+            return;
+        // A car moves back into the hole unless its home bucket lies after the hole
+        home = carBucket(maxHeap->array[table[bucket]], bits);
+        if(((bucket - home) & mask) < ((bucket - hole) & mask))
+            continue;
+        table[hole] = table[bucket];
+        positions[table[hole]] = (int) hole;
+        table[bucket] = EMPTY_BUCKET;
+        hole = bucket;
+    }
+}
 
-    entry->maxRange = maxRange;
-    entry->stationIndex = stationIndex;
-    entry->next = NULL;
+int findCar(pMaxHeap maxHeap, unsigned int carID) {
+    int bits = carIndexBits(maxHeap->capacity);
+    unsigned int mask = (1u << bits) - 1;
+    int* table = (int*) (maxHeap->array + 2 * maxHeap->capacity);
+    unsigned int bucket;
+    int i;
 
-    if(queue->head == NULL) {
-        queue->head = entry;
-        queue->tail = entry;
-        return;
+    if(bits == 0) {
+        i = scanCars(maxHeap->array, maxHeap->numOfCars, carID);
+        COUNT(carScanLength, i >= 0 ? i + 1 : maxHeap->numOfCars);
+        return i;
+    }
+    // Any car with the given range will do, cars with the same range are interchangeable
+    for(bucket = carBucket(carID, bits); table[bucket] != EMPTY_BUCKET; bucket = (bucket + 1) & mask) {
+        COUNT(carScanLength, 1);
+        if(maxHeap->array[table[bucket]] == carID)
+            return table[bucket];
+    }
+    return -1;
+}
+
+int scanCars(const unsigned int* cars, int numberOfCars, unsigned int carID) {
+#ifdef CAR_SCAN_SIMD
+    // Below eight cars the scalar loop is as fast, the check of AVX2 reads a flag set once when the program starts
+    if(numberOfCars >= 8)
+        return __builtin_cpu_supports("avx2") ? scanCarsAvx2(cars, numberOfCars, carID) : scanCarsSse2(cars, numberOfCars, carID);
+#endif
+    return scanCarsScalar(cars, numberOfCars, carID);
+}
+
+int scanCarsScalar(const unsigned int* cars, int numberOfCars, unsigned int carID) {
+    int i;
+
+    for(i = 0; i < numberOfCars; i++)
+        if(cars[i] == carID)
+            return i;
+    return -1;
+}
+
+#ifdef CAR_SCAN_SIMD
+int scanCarsSse2(const unsigned int* cars, int numberOfCars, unsigned int carID) {
+    __m128i key = _mm_set1_epi32((int) carID);
+    int found;
+    int i;
+
+    for(i = 0; i + 4 <= numberOfCars; i += 4) {
+        found = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (cars + i)), key)));
+        if(found != 0) //one bit for each car with the range, the lowest is the first one
+            return i + __builtin_ctz(found);
+    }
+    // The last cars are compared together with some already compared, which cannot match
+    if(i < numberOfCars) {
+        found = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (cars + numberOfCars - 4)), key)));
+        if(found != 0)
+            return numberOfCars - 4 + __builtin_ctz(found);
+    }
+    return -1;
+}
+
+__attribute__((target("avx2")))
+int scanCarsAvx2(const unsigned int* cars, int numberOfCars, unsigned int carID) {
+    __m256i key = _mm256_set1_epi32((int) carID);
+    int found;
+    int i;
+
+    for(i = 0; i + 8 <= numberOfCars; i += 8) {
+        found = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*) (cars + i)), key)));
+        if(found != 0)
+            return i + __builtin_ctz(found);
+    }
+    if(i < numberOfCars) {
+        found = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*) (cars + numberOfCars - 8)), key)));
+        if(found != 0)
+            return numberOfCars - 8 + __builtin_ctz(found);
+    }
+    return -1;
+}
+#endif
+
+void moveCar(pMaxHeap maxHeap, int from, int to) {
+    int* positions = (int*) (maxHeap->array + maxHeap->capacity);
+
+    maxHeap->array[to] = maxHeap->array[from];
+    if(maxHeap->capacity > INDEXED_CARS) {
+        positions[to] = positions[from];
+        positions[maxHeap->capacity + positions[to]] = to; //the hash table follows the positions
+    }
+}
+
+void swapCars(pMaxHeap maxHeap, int first, int second) {
+    int* positions = (int*) (maxHeap->array + maxHeap->capacity);
+    unsigned int car = maxHeap->array[first];
+    int position;
+
+    maxHeap->array[first] = maxHeap->array[second];
+    maxHeap->array[second] = car;
+    if(maxHeap->capacity > INDEXED_CARS) {
+        position = positions[first];
+        positions[first] = positions[second];
+        positions[second] = position;
+        positions[maxHeap->capacity + positions[first]] = first;
+        positions[maxHeap->capacity + positions[second]] = second;
+    }
+}
+
+void freeMaxHeap(pStationIndex index, pMaxHeap maxHeap) {
+    if(maxHeap->array != maxHeap->inlineCars)
+        free(maxHeap->array);
+    poolFree(&index->carsPool, maxHeap);
+}
+
+void* poolAlloc(Pool* pool) {
+    void* object = pool->freeList;
+    void* slab;
+
+    if(object != NULL) {// Reuse the last object returned
+        pool->freeList = *(void**) object;
+        pool->objectsInUse++;
+        return object;
     }
 
-    queue->tail->next = entry;
-    queue->tail = entry;
+    if(pool->nextObject == pool->slabEnd) {// The current slab is exhausted, a new one is needed
+        slab = malloc(sizeof(void*) + POOL_SLAB_OBJECTS * pool->objectSize);
+        if(slab == NULL) {
+            exit(11);
+        }
+        *(void**) slab = pool->slabs;
+        pool->slabs = slab;
+        pool->nextObject = (char*) slab + sizeof(void*);
+        pool->slabEnd = pool->nextObject + POOL_SLAB_OBJECTS * pool->objectSize;
+        pool->capacity += POOL_SLAB_OBJECTS;
+    }
+
+    object = pool->nextObject;
+    pool->nextObject += pool->objectSize;
+    pool->objectsInUse++;
+    return object;
+}
+
+void poolFree(Pool* pool, void* object) {
+    *(void**) object = pool->freeList;
+    pool->freeList = object;
+    pool->objectsInUse--;
+}
+
+void releasePool(Pool* pool) {
+    void* slab;
+
+    while(pool->slabs != NULL) {
+        slab = pool->slabs;
+        pool->slabs = *(void**) slab;
+        free(slab);
+    }
+    pool->freeList = NULL;
+    pool->nextObject = pool->slabEnd = NULL;
+    pool->objectsInUse = pool->capacity = 0;
+}
+
+void initPlannerWorkspace(PlannerWorkspace* workspace) {
+    workspace->levelEnds = newVector(PLANNER_INITIAL_SIZE);
+    workspace->route = newVector(PLANNER_INITIAL_SIZE);
+    workspace->visited = 0;
+}
+
+void resetPlannerWorkspace(PlannerWorkspace* workspace) {
+    workspace->levelEnds->numberOfElements = 0;
+    workspace->route->numberOfElements = 0;
+    workspace->visited = 0;
 }
 
-pQueue newQueue() {
-    pQueue queue = (pQueue) malloc(sizeof(Queue));
-    queue->head = NULL;
-    queue->tail = NULL;
-    return queue;
+void freePlannerWorkspace(PlannerWorkspace* workspace) {
+    freeVector(workspace->levelEnds);
+    freeVector(workspace->route);
 }
 
 int addVector(Vector *vector, unsigned int value) {
@@ -1178,6 +4371,18 @@ int addVector(Vector *vector, unsigned int value) {
     return 1;
 }
 
+void reverseVector(Vector* vector) {
+    int i = 0;
+    int j = vector->numberOfElements - 1;
+    unsigned int temp;
+
+    while(i < j) {
+        temp = vector->array[i];
+        vector->array[i++] = vector->array[j];
+        vector->array[j--] = temp;
+    }
+}
+
 void freeVector(Vector* vector) {
     if(vector != NULL) {
         if(vector->array != NULL) {
@@ -1204,115 +4409,464 @@ Vector *newVector(int size) {
     return vector;
 }
 
-pLinkedList newLinkedList() {
-    LinkedList* list = (LinkedList*)malloc(sizeof(LinkedList));
-    list->head = NULL;
-    list->bestMinRange = -1;
-    list->bestStationIndex = -1;
-    list->bestSteps = -1;
-    return list;
+#ifndef HIGHWAY_LIBRARY
+void initInput(int fd) {
+    struct stat info;
+    void* mapped;
+
+    input.fd = fd;
+    input.endOfFile = 0;
+    input.mapping = NULL;
+
+    if(fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        mapped = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapped != MAP_FAILED) { //the whole file is available, there is nothing left to read
+            madvise(mapped, (size_t) info.st_size, MADV_SEQUENTIAL);
+            input.mapping = (const char*) mapped;
+            input.mappingLength = (size_t) info.st_size;
+            input.current = input.mapping;
+            input.end = input.current + info.st_size;
+            input.endOfFile = 1;
+            return;
+        }
+    }
+
+    if(input.block == NULL)
+        input.block = (char*) malloc(INPUT_BLOCK_SIZE);
+    input.current = input.end = input.block;
 }
 
-pElement createElement(int minRange, int stationIndex, int steps) {
-    pElement newElement = (pElement)malloc(sizeof(Element));
-    newElement->minRange = minRange;
-    newElement->stationIndex = stationIndex;
-    newElement->steps = steps;
-    newElement->next = NULL;
-    return newElement;
+void releaseInput() {
+    if(input.mapping != NULL)
+        munmap((void*) input.mapping, input.mappingLength);
+    input.mapping = NULL;
+    input.current = input.end = input.block;
 }
 
-void insertLinked(LinkedList *list, int minRange, int stationIndex, int steps) {
-    Element* newElement = createElement(minRange, stationIndex, steps);
-    if(list->bestMinRange == -1) {
-        list->bestMinRange = minRange;
-        list->bestSteps = steps;
-        list->bestStationIndex = stationIndex;
-    } else {
-        if(list->bestMinRange >= minRange && list->bestSteps >= steps) {
-            list->bestMinRange = minRange;
-            list->bestSteps = steps;
-            list->bestStationIndex = stationIndex;
-        }
+int refillInput() {
+    size_t pending = input.end - input.current;
+    ssize_t bytesRead;
+
+    if(input.endOfFile || pending == INPUT_BLOCK_SIZE) //a single token can never fill a whole block
+        return 0;
+
+#ifdef HIGHWAY_PIPELINE
+    if(pipeline.running)
+        setRefilling(&pipeline, 1); //the replies are written by the executor once it has no command left
+    else
+#endif
+    writeReplies(); //the replies must be visible before waiting for more commands
+
+    memmove(input.block, input.current, pending);
+    input.current = input.block;
+    input.end = input.block + pending;
+
+    do {
+        bytesRead = read(input.fd, input.block + pending, INPUT_BLOCK_SIZE - pending);
+    } while(bytesRead < 0 && errno == EINTR);
+#ifdef HIGHWAY_PIPELINE
+    if(pipeline.running)
+        setRefilling(&pipeline, 0);
+#endif
+
+    if(bytesRead <= 0) {
+        input.endOfFile = 1;
+        return 0;
     }
-    newElement->next = list->head;
-    list->head = newElement;
+    input.end += bytesRead;
+    return 1;
 }
 
-void freeLinkedList(LinkedList* list) {
-    Element* current = list->head;
-    Element* next;
+const char* nextToken(int* length, int* terminator) {
+    const char* p = input.current;
+    size_t scanned;
 
-    while (current != NULL) {
-        next = current->next;
-        free(current);
-        current = next;
+    for(;;) {
+        //same characters as isspace() in the C locale
+        while(p < input.end && *p != ' ' && (*p < '\t' || *p > '\r'))
+            p++;
+        if(p < input.end || input.endOfFile)
+            break;
+        //the token continues in the next block, refilling moves it to the beginning of the block
+        scanned = p - input.current;
+        if(refillInput() == 0)
+            break;
+        p = input.current + scanned;
     }
 
-    free(list);
+    const char* token = input.current;
+    *length = (int) (p - token);
+    if(p < input.end) {
+        *terminator = (unsigned char) *p;
+        input.current = p + 1;
+    } else {
+        *terminator = EOF;
+        input.current = p;
+    }
+    return token;
 }
 
-Action readAction() {
-    char buffer[BUFFER_SIZE];
-    int ch;
-    int i = 0;
-
-    //read string from input stream
-    while(isspace(ch = getchar()) == 0 && ch !='\n' && ch != EOF) {
-        buffer[i] = (char) ch;
-        i++;
+unsigned int parseDigits(const char* digits, int length) {
+    unsigned int value = 0;
+    uint64_t chunk;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while(length >= 8) { //SWAR conversion: pairs, then quadruples, then the eight digits together
+        memcpy(&chunk, digits, sizeof(chunk));
+        chunk -= 0x3030303030303030ULL;
+        chunk = (chunk * 10) + (chunk >> 8);
+        chunk = (((chunk & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+                 (((chunk >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+        value = value * 100000000U + (unsigned int) chunk;
+        digits += 8;
+        length -= 8;
     }
+#endif
+    while(length > 0) {
+        value = value * 10 + (unsigned int) (*digits - '0');
+        digits++;
+        length--;
+    }
+    return value;
+}
 
-    if(ch == '\n' || ch == EOF) //if ch == '\n' or ch == EOF, then the input stream is empty
+Action readAction() {
+    int length;
+    int terminator;
+    const char* token;
+    Action action;
+#ifdef HIGHWAY_PIPELINE
+    uint64_t word;
+
+    if(pipeline.running) {// The parser thread already decoded the command
+        giveBackWords(&pipeline);
+        word = takeWord(&pipeline);
+        if(word >= INVALIDACTION) {// A number in place of an action is as invalid as an unknown action
+            writeReplies(); //the commands before it are answered first
+            exit(5);
+        }
+        return (Action) word;
+    }
+#endif
+    token = nextToken(&length, &terminator);
+    if(terminator == '\n' || terminator == EOF) //if the token ends the line or the input, then the input stream is empty
         return ENDINPUT;
+    action = decodeAction(token, length);
+    if(action == INVALIDACTION) { //if the action is not valid, exit the program
+        writeReplies(); //the commands before it are answered first
+        exit(5);
+    }
+    return action;
+}
 
+Action decodeAction(const char* token, int length) {
     //check which action to perform
-    if(buffer[0] == 'p') //check if the action is plan route
+    if(length > 0 && token[0] == 'p') //check if the action is plan route
         return PLANROUTE;
 
-    else if(buffer[0] == 'a') { //check if the action is add or remove
+    else if(length > 0 && token[0] == 'a') { //check if the action is add or remove
 
-        if(buffer[9] == 's') //check if the action is add station or add station
+        if(length > 9 && token[9] == 's') //check if the action is add station or add station
             return ADDSTATION;
         else
             return ADDCAR;
     }
-    else if(buffer[0] == 'd') { //check if the action is remove station or remove car
+    else if(length > 0 && token[0] == 'd') { //check if the action is remove station or remove car
         return RMVSTATION;
-    } else if(buffer[0] == 'r') {
+    } else if(length > 0 && token[0] == 'r') {
         return RMVCAR;
     }
-    else{ //if the action is not valid, exit the program
-        exit(5);
+    else{ //the action is not valid
+        return INVALIDACTION;
     }
 }
 
 int readInt(unsigned int *number) {
-    char buffer[BUFFER_SIZE];
-    unsigned int value = 0;
-    int ch;
-    int i = 0;
-    int j;
-    int p = 1;
+    int length;
+    int terminator;
+    const char* token;
+#ifdef HIGHWAY_PIPELINE
+    uint64_t word;
+
+    if(pipeline.running) {
+        word = takeWord(&pipeline);
+        *number = (unsigned int) word;
+        return (word & LAST_ON_LINE) == 0;
+    }
+#endif
+
+    token = nextToken(&length, &terminator);
+    *number = parseDigits(token, length);
+
+    if(terminator == '\n' || terminator == EOF) //if the number ends the line or the input, then the input stream is empty
+        return 0;
+    else //there are some other number to check
+        return 1;
+}
+
+void writeReplies() {
+#ifdef HIGHWAY_PARALLEL
+    finishQueries(&plannerPool); //the queries read so far are answered first
+#endif
+    flushOutput();
+}
+
+#ifdef HIGHWAY_PIPELINE
+int startPipeline(CommandPipeline* pipeline) {
+    const char* setting = getenv("HIGHWAY_PIPELINE");
+
+    if(setting != NULL ? atoi(setting) == 0 : sysconf(_SC_NPROCESSORS_ONLN) < 2)
+        return 0; //parsing could not overlap with the commands
+    pipeline->written = pipeline->room = pipeline->head = 0;
+    pipeline->taken = pipeline->visible = pipeline->tail = 0;
+    pipeline->parserWaiting = pipeline->executorWaiting = pipeline->refilling = 0;
+    pthread_mutex_init(&pipeline->lock, NULL);
+    pthread_cond_init(&pipeline->wakeUp, NULL);
+    pipeline->running = 1; //set before the parser starts, refillInput reads it
+    if(pthread_create(&pipeline->parser, NULL, runParser, pipeline) != 0) {
+        pipeline->running = 0;
+        return 0;
+    }
+    return 1;
+}
+
+void stopPipeline(CommandPipeline* pipeline) {
+    pthread_join(pipeline->parser, NULL);
+    pipeline->running = 0;
+}
+
+void* runParser(void* argument) {
+    CommandPipeline* pipeline = (CommandPipeline*) argument;
+    const char* token;
+    int length;
+    int terminator;
+    Action action;
+
+    do {
+        // Same tokens as readAction, then one for each readInt of the command, so the line ends are not a boundary
+        token = nextToken(&length, &terminator);
+        action = terminator == '\n' || terminator == EOF ? ENDINPUT : decodeAction(token, length);
+        putWord(pipeline, action);
+        switch(action) {
+            case ADDSTATION: //the station, then the numbers of readCars up to the end of the line
+                putNumber(pipeline);
+                if(putNumber(pipeline))
+                    while(putNumber(pipeline));
+                break;
+            case RMVSTATION:
+                putNumber(pipeline);
+                break;
+            case ADDCAR:
+            case RMVCAR:
+            case PLANROUTE:
+                putNumber(pipeline);
+                putNumber(pipeline);
+                break;
+            default: //nothing follows the end of the input or an invalid action
+                break;
+        }
+        publishWords(pipeline);
+    } while(action != ENDINPUT && action != INVALIDACTION);
+    return NULL;
+}
 
-    while(isspace(ch = getchar()) == 0 && ch !='\n' && ch != EOF) {
-        buffer[i] = (char) ch;
-        i++;
+int putNumber(CommandPipeline* pipeline) {
+    const char* token;
+    int length;
+    int terminator;
+    int last;
+
+    token = nextToken(&length, &terminator);
+    last = terminator == '\n' || terminator == EOF;
+    putWord(pipeline, parseDigits(token, length) | (last ? LAST_ON_LINE : 0));
+    return !last;
+}
+
+void putWord(CommandPipeline* pipeline, uint64_t word) {
+    if(pipeline->written - pipeline->room == COMMAND_RING_SIZE) {
+        pipeline->room = __atomic_load_n(&pipeline->tail, __ATOMIC_ACQUIRE);
+        if(pipeline->written - pipeline->room == COMMAND_RING_SIZE)
+            waitForRoom(pipeline);
+    }
+    pipeline->words[pipeline->written++ % COMMAND_RING_SIZE] = word;
+}
+
+void publishWords(CommandPipeline* pipeline) {
+    __atomic_store_n(&pipeline->head, pipeline->written, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&pipeline->executorWaiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&pipeline->lock);
+        pthread_cond_signal(&pipeline->wakeUp);
+        pthread_mutex_unlock(&pipeline->lock);
     }
+}
 
-    //add null terminator to the end of the string
-    buffer[i] = '\0';
+void waitForRoom(CommandPipeline* pipeline) {
+    int spins;
 
-    for(j = (i - 1); j >= 0; j--) { //convert string to int
-        value = value + (buffer[j] - '0') * p;
-        p = p * 10;
+    publishWords(pipeline); //a line longer than the ring is taken while it is being written
+    for(spins = 0; spins < PIPELINE_SPINS; spins++) {
+        pipeline->room = __atomic_load_n(&pipeline->tail, __ATOMIC_ACQUIRE);
+        if(pipeline->written - pipeline->room < COMMAND_RING_SIZE)
+            return;
     }
+    // The executor checks parserWaiting after moving tail, and it is set here before tail is read again
+    pthread_mutex_lock(&pipeline->lock);
+    __atomic_store_n(&pipeline->parserWaiting, 1, __ATOMIC_SEQ_CST);
+    while(pipeline->written - (pipeline->room = __atomic_load_n(&pipeline->tail, __ATOMIC_SEQ_CST)) == COMMAND_RING_SIZE)
+        pthread_cond_wait(&pipeline->wakeUp, &pipeline->lock);
+    __atomic_store_n(&pipeline->parserWaiting, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&pipeline->lock);
+}
 
-    *number = value;
+void setRefilling(CommandPipeline* pipeline, int refilling) {
+    __atomic_store_n(&pipeline->refilling, refilling, __ATOMIC_SEQ_CST);
+    if(refilling && __atomic_load_n(&pipeline->executorWaiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&pipeline->lock);
+        pthread_cond_signal(&pipeline->wakeUp);
+        pthread_mutex_unlock(&pipeline->lock);
+    }
+}
 
-    if(ch == '\n' || ch == EOF) //if ch == '\n' or ch == EOF, then the input stream is empty
-        return 0;
-    else //there are some other number to check
-        return 1;
+uint64_t takeWord(CommandPipeline* pipeline) {
+    if(pipeline->taken == pipeline->visible) {
+        pipeline->visible = __atomic_load_n(&pipeline->head, __ATOMIC_ACQUIRE);
+        if(pipeline->taken == pipeline->visible)
+            waitForWords(pipeline);
+    }
+    return pipeline->words[pipeline->taken++ % COMMAND_RING_SIZE];
+}
+
+void waitForWords(CommandPipeline* pipeline) {
+    int written = 0; //1 once the replies were written for a parser waiting for input
+    int spins;
+
+    giveBackWords(pipeline); //the parser may be waiting for room in the middle of a long line
+    for(spins = 0; spins < PIPELINE_SPINS; spins++) {
+        pipeline->visible = __atomic_load_n(&pipeline->head, __ATOMIC_ACQUIRE);
+        if(pipeline->taken != pipeline->visible)
+            return;
+    }
+    // The parser checks executorWaiting after moving head or starting a refill, and it is set here before they are read again
+    pthread_mutex_lock(&pipeline->lock);
+    __atomic_store_n(&pipeline->executorWaiting, 1, __ATOMIC_SEQ_CST);
+    while((pipeline->visible = __atomic_load_n(&pipeline->head, __ATOMIC_SEQ_CST)) == pipeline->taken) {
+        if(!written && __atomic_load_n(&pipeline->refilling, __ATOMIC_SEQ_CST)) {// Nothing else can be performed before more input arrives
+            pthread_mutex_unlock(&pipeline->lock);
+            writeReplies();
+            written = 1;
+            pthread_mutex_lock(&pipeline->lock);
+            continue;
+        }
+        pthread_cond_wait(&pipeline->wakeUp, &pipeline->lock);
+    }
+    __atomic_store_n(&pipeline->executorWaiting, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&pipeline->lock);
+}
+
+void giveBackWords(CommandPipeline* pipeline) {
+    __atomic_store_n(&pipeline->tail, pipeline->taken, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&pipeline->parserWaiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&pipeline->lock);
+        pthread_cond_signal(&pipeline->wakeUp);
+        pthread_mutex_unlock(&pipeline->lock);
+    }
+}
+#endif
+
+void flushOutput() {
+    int written = 0;
+    ssize_t result;
+    char* heldData;
+
+    if(output.held) {// The characters wait for the answers that have to be written before them
+        if(output.heldLength + output.length > output.heldCapacity) {
+            heldData = (char*) realloc(output.heldData, 2 * (output.heldLength + output.length));
+            if(heldData == NULL) {
+                exit(7);
+            }
+            output.heldData = heldData;
+            output.heldCapacity = 2 * (output.heldLength + output.length);
+        }
+        memcpy(output.heldData + output.heldLength, output.data, output.length);
+        output.heldLength += output.length;
+        output.length = 0;
+        return;
+    }
+
+    while(written < output.length) {
+        result = write(output.fd, output.data + written, (size_t) (output.length - written));
+        if(result < 0) {
+            if(errno == EINTR)
+                continue;
+            break; //the output is closed, the replies are lost anyway
+        }
+        written += (int) result;
+    }
+    output.length = 0;
+}
+
+void holdOutput() {
+    flushOutput();
+    output.held = 1;
+}
+
+void writeHeldOutput() {
+    size_t written = 0;
+    size_t chunk;
+
+    while(written < output.heldLength) {
+        if(output.length == OUTPUT_BUFFER_SIZE)
+            flushOutput();
+        chunk = output.heldLength - written;
+        if(chunk > (size_t) (OUTPUT_BUFFER_SIZE - output.length))
+            chunk = OUTPUT_BUFFER_SIZE - output.length;
+        memcpy(output.data + output.length, output.heldData + written, chunk);
+        output.length += (int) chunk;
+        written += chunk;
+    }
+    output.heldLength = 0;
+}
+
+void writeText(const char* text) {
+    while(*text != '\0') {
+        if(output.length == OUTPUT_BUFFER_SIZE)
+            flushOutput();
+        output.data[output.length++] = *text++;
+    }
+}
+
+void writeUnsigned(unsigned int value) {
+    static const char digitPairs[] =
+            "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+            "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+    char digits[MAX_UNSIGNED_DIGITS];
+    int i = MAX_UNSIGNED_DIGITS;
+    unsigned int pair;
+
+    //digits are produced from the least significant, two at a time
+    while(value >= 100) {
+        pair = (value % 100) * 2;
+        value /= 100;
+        digits[--i] = digitPairs[pair + 1];
+        digits[--i] = digitPairs[pair];
+    }
+    if(value >= 10) {
+        digits[--i] = digitPairs[value * 2 + 1];
+        digits[--i] = digitPairs[value * 2];
+    } else {
+        digits[--i] = (char) ('0' + value);
+    }
+
+    if(output.length + MAX_UNSIGNED_DIGITS > OUTPUT_BUFFER_SIZE)
+        flushOutput();
+    memcpy(output.data + output.length, digits + i, (size_t) (MAX_UNSIGNED_DIGITS - i));
+    output.length += MAX_UNSIGNED_DIGITS - i;
 }
 
+void writeChar(char character) {
+    if(output.length == OUTPUT_BUFFER_SIZE)
+        flushOutput();
+    output.data[output.length++] = character;
+}
+#endif
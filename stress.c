@@ -0,0 +1,645 @@
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+#include "highway.h"
+
+/*
+ * Stress test of the highway library: a seeded random workload is executed both on a Highway and on a plain model of
+ * the stations. The number of stops of every route planned by the library is compared with the one of a brute force
+ * breadth first search on the model, and the route is checked stop by stop. When there are few routes with the fewest
+ * stops they are all listed, and the route of the library must be the one the definition prefers.
+ * Usage: stress [seed [stations [operations]]]
+ *
+ * exit codes:
+ *  1 - the library and the oracle disagree
+ *  2 - invalid arguments
+ *  3 - memory not allocated
+*/
+
+#define DEFAULT_SEED 1 //seed used when none is given
+#define DEFAULT_STATIONS 20000 //stations added before the random operations when no number is given
+#define DEFAULT_OPERATIONS 4000 //random operations executed when no number is given
+#define FINAL_QUERIES 2500 //route queries after the random operations, with no change in between
+#define STATION_GAP 16 //average distance between two stations
+#define MAX_INITIAL_CARS 8 //maximum number of cars of a new station, depots excluded
+#define DEPOT_CARS 512 //number of cars of a depot
+#define DEPOT_ONE_IN 500 //one new station in DEPOT_ONE_IN is a depot
+#define NEARBY_STATIONS 1000 //routes between close stations end at most NEARBY_STATIONS stations away from their start
+#define CLOSE_STATIONS 16 //some routes end at most CLOSE_STATIONS stations away from their start, so that they can be listed
+#define MAX_LISTED_ROUTES 4096 //the routes with the fewest stops are listed only when there are at most this many
+
+/* Data Structures */
+/*
+ * Description: station of the model, with its cars in no particular order
+ * Values:
+ *   - stationID: distance of the station from the start of the highway
+ *   - cars: range of each car
+ *   - numberOfCars: number of cars in cars
+ *   - capacity: number of cars that fit in cars
+ */
+typedef struct modelStation {
+    unsigned int stationID;
+    unsigned int* cars;
+    int numberOfCars;
+    int capacity;
+}ModelStation;
+/*
+ * Description: stations of the highway kept in the simplest possible way, together with the buffers of the oracle
+ * Values:
+ *   - stations: stations sorted by stationID
+ *   - numberOfStations: number of stations in stations
+ *   - capacity: number of stations that fit in stations and in the buffers
+ *   - distance: stops needed to get to each station from the start of the route, -1 if not reached
+ *   - queue: positions of the stations reached, in the order they were reached
+ *   - reach: largest car range of each station
+ *   - levelStart: position in queue of the first station of each distance, the stations of a distance are contiguous
+ *   - ways: routes with the fewest stops from each station to the end of the route, up to MAX_LISTED_ROUTES + 1
+ *   - route: route being listed
+ */
+typedef struct model {
+    ModelStation* stations;
+    int numberOfStations;
+    int capacity;
+    int* distance;
+    int* queue;
+    unsigned int* reach;
+    int* levelStart;
+    int* ways;
+    unsigned int* route;
+}Model;
+/*
+ * Description: parameters of a workload, drawn from the seed
+ * Values:
+ *   - random: state of the random number generator
+ *   - span: stationIDs are drawn from 0 to span
+ *   - maxRange: largest car range drawn
+ */
+typedef struct workload {
+    unsigned long long random;
+    unsigned int span;
+    unsigned int maxRange;
+}Workload;
+
+/* Function Prototypes */
+/*
+ * Function: nextRandom
+ * Description: draws the next number of a splitmix64 generator, the same on every platform for the same seed
+ * Parameters:
+ *   - workload: pointer to the workload with the state of the generator
+ * Returns: random number
+ */
+unsigned long long nextRandom(Workload* workload);
+/*
+ * Function: randomBelow
+ * Description: draws a random number smaller than bound
+ * Parameters:
+ *   - workload: pointer to the workload
+ *   - bound: upper bound, greater than 0
+ * Returns: random number from 0 to bound - 1
+ */
+unsigned int randomBelow(Workload* workload, unsigned int bound);
+/*
+ * Function: allocate
+ * Description: malloc that stops the program with exit code 3 when it fails
+ * Parameters:
+ *   - size: number of bytes
+ * Returns: pointer to the memory
+ */
+void* allocate(size_t size);
+/*
+ * Function: findModelStation
+ * Description: binary search of a station in the model
+ * Parameters:
+ *   - model: pointer to the model
+ *   - stationID: ID of the station
+ * Returns: position of the station, or of the first station with a greater ID if it is not in the model
+ */
+int findModelStation(Model* model, unsigned int stationID);
+/*
+ * Function: addModelStation
+ * Description: adds a station with its cars to the model
+ * Parameters:
+ *   - model: pointer to the model
+ *   - stationID: ID of the station
+ *   - cars: range of each car
+ *   - numberOfCars: number of cars in cars
+ * Returns: 1 if the station was added, 0 if it already exists
+ */
+int addModelStation(Model* model, unsigned int stationID, const unsigned int* cars, int numberOfCars);
+/*
+ * Function: removeModelStation
+ * Description: removes a station from the model
+ * Parameters:
+ *   - model: pointer to the model
+ *   - stationID: ID of the station
+ * Returns: 1 if the station was removed, 0 if it does not exist
+ */
+int removeModelStation(Model* model, unsigned int stationID);
+/*
+ * Function: addModelCar
+ * Description: adds a car to a station of the model
+ * Parameters:
+ *   - model: pointer to the model
+ *   - stationID: ID of the station
+ *   - carID: range of the car
+ * Returns: 1 if the car was added, 0 if the station does not exist
+ */
+int addModelCar(Model* model, unsigned int stationID, unsigned int carID);
+/*
+ * Function: removeModelCar
+ * Description: removes one car with the given range from a station of the model
+ * Parameters:
+ *   - model: pointer to the model
+ *   - stationID: ID of the station
+ *   - carID: range of the car
+ * Returns: 1 if the car was removed, 0 if the station does not exist or has no car with that range
+ */
+int removeModelCar(Model* model, unsigned int stationID, unsigned int carID);
+/*
+ * Function: reaches
+ * Description: checks whether a car of a station of the model gets to another station, with the reach computed by oracleRoute
+ * Parameters:
+ *   - model: pointer to the model
+ *   - from: position of the station the car leaves from
+ *   - to: position of the station to get to
+ * Returns: 1 if the largest range of from is at least the distance between the two stations, 0 otherwise
+ */
+int reaches(Model* model, int from, int to);
+/*
+ * Function: oracleRoute
+ * Description: counts the stops of the route with a breadth first search that follows every pair of stations where one
+ *              reaches the other, in O(n + number of pairs), n the stations between start and end. Then it counts the
+ *              routes with the fewest stops and, if there are at most MAX_LISTED_ROUTES, lists them all and keeps the
+ *              one preferredRoute chooses
+ * Parameters:
+ *   - model: pointer to the model
+ *   - start: start station
+ *   - end: end station
+ *   - stops: array to store the stations of the preferred route, with room for every station of the model
+ *   - listed: pointer to store 1 if the routes were listed and stops holds the preferred one, 0 otherwise
+ * Returns: number of stations in the route, 0 if there is no route
+ */
+int oracleRoute(Model* model, unsigned int start, unsigned int end, unsigned int* stops, int* listed);
+/*
+ * Function: listRoutes
+ * Description: lists every route with the fewest stops that continues model->route from the station at position
+ *              current, and keeps in stops the one preferredRoute chooses
+ * Parameters:
+ *   - model: pointer to the model
+ *   - current: position of the last station of the route so far
+ *   - level: number of stops before current
+ *   - last: position of the end station
+ *   - stops: preferred route so far, valid only if *found is 1
+ *   - found: pointer to 1 once a route was stored in stops
+ * Returns: void
+ */
+void listRoutes(Model* model, int current, int level, int last, unsigned int* stops, int* found);
+/*
+ * Function: preferredRoute
+ * Description: the rule of the task among routes with the fewest stops: the one with the stops closest to the start of
+ *              the highway. The routes are compared from their end, the first stop where they differ decides
+ * Parameters:
+ *   - route: stations of a route
+ *   - other: stations of another route with as many stops
+ *   - numberOfStops: number of stations in each route
+ * Returns: 1 if route is preferred to other, 0 otherwise
+ */
+int preferredRoute(const unsigned int* route, const unsigned int* other, int numberOfStops);
+/*
+ * Function: checkRoute
+ * Description: checks that a route goes from start to end through stations of the model, each one towards end and
+ *              reaching the following one, with the reach computed by the last oracleRoute between the same stations
+ * Parameters:
+ *   - model: pointer to the model
+ *   - stops: stations of the route
+ *   - numberOfStops: number of stations in stops
+ *   - start: start station
+ *   - end: end station
+ * Returns: 1 if the route is valid, 0 otherwise
+ */
+int checkRoute(Model* model, const unsigned int* stops, int numberOfStops, unsigned int start, unsigned int end);
+/*
+ * Function: randomStationID
+ * Description: draws the ID of a station of the model, or a random ID one time in ten
+ * Parameters:
+ *   - model: pointer to the model
+ *   - workload: pointer to the workload
+ * Returns: stationID
+ */
+unsigned int randomStationID(Model* model, Workload* workload);
+/*
+ * Function: elapsed
+ * Description: nanoseconds between two instants
+ * Parameters:
+ *   - from: first instant
+ *   - to: second instant
+ * Returns: nanoseconds from from to to
+ */
+long long elapsed(struct timespec from, struct timespec to);
+
+/* Main */
+int main(int argc, char** argv) {
+    unsigned long long seed = argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_SEED;
+    long numberOfStations = argc > 2 ? atol(argv[2]) : DEFAULT_STATIONS;
+    long numberOfOperations = argc > 3 ? atol(argv[3]) : DEFAULT_OPERATIONS;
+    Workload workload = {.random = seed};
+    Model model = {0};
+    Highway* highway;
+    unsigned int cars[DEPOT_CARS];
+    unsigned int* libraryStops;
+    unsigned int* oracleStops;
+    unsigned int stationID;
+    unsigned int start;
+    unsigned int end;
+    struct timespec before;
+    struct timespec middle;
+    struct timespec after;
+    long long libraryTime = 0;
+    long long oracleTime = 0;
+    long queries = 0;
+    long routes = 0;
+    long stops = 0;
+    long listedQueries = 0;
+    long operation;
+    int numberOfCars;
+    int libraryAnswer;
+    int libraryCount;
+    int oracleAnswer;
+    int listed;
+    int choice;
+    int i;
+
+    if(argc > 4 || numberOfStations < 2 || numberOfOperations < 0) {
+        fprintf(stderr, "usage: %s [seed [stations [operations]]]\n", argv[0]);
+        exit(2);
+    }
+    // Every seed draws its own shape of highway, from routes of a few stops to routes of thousands of stops
+    workload.span = (unsigned int) numberOfStations * STATION_GAP;
+    workload.maxRange = STATION_GAP << (1 + randomBelow(&workload, 7));
+    model.capacity = (int) (numberOfStations + numberOfOperations + 1);
+    model.stations = allocate(model.capacity * sizeof(ModelStation));
+    model.distance = allocate(model.capacity * sizeof(int));
+    model.queue = allocate(model.capacity * sizeof(int));
+    model.reach = allocate(model.capacity * sizeof(unsigned int));
+    model.levelStart = allocate((model.capacity + 1) * sizeof(int));
+    model.ways = allocate(model.capacity * sizeof(int));
+    model.route = allocate(model.capacity * sizeof(unsigned int));
+    libraryStops = allocate(model.capacity * sizeof(unsigned int));
+    oracleStops = allocate(model.capacity * sizeof(unsigned int));
+    for(i = 0; i < model.capacity; i++)
+        model.distance[i] = -1;
+    highway = createHighway();
+    if(highway == NULL)
+        exit(3);
+
+    /*
+     * The operations are executed on both sides and their answers compared, a route query is timed on each side.
+     * The first numberOfStations operations only add stations, the last FINAL_QUERIES only plan routes, so that
+     * the indexes rebuilt when the stations stop changing, as the jump index, answer some of them.
+     */
+    for(operation = 0; operation < numberOfStations + numberOfOperations + FINAL_QUERIES; operation++) {
+        if(operation < numberOfStations)
+            choice = 0;
+        else if(operation < numberOfStations + numberOfOperations)
+            choice = (int) randomBelow(&workload, 10);
+        else
+            choice = 9;
+        if(choice == 0) {
+            stationID = randomBelow(&workload, workload.span + 1);
+            numberOfCars = randomBelow(&workload, DEPOT_ONE_IN) == 0 ? DEPOT_CARS : (int) randomBelow(&workload, MAX_INITIAL_CARS + 1);
+            for(i = 0; i < numberOfCars; i++)
+                cars[i] = randomBelow(&workload, workload.maxRange + 1);
+            libraryAnswer = highwayAddStation(highway, stationID, cars, numberOfCars);
+            oracleAnswer = addModelStation(&model, stationID, cars, numberOfCars);
+        } else if(choice == 1) {
+            stationID = randomStationID(&model, &workload);
+            libraryAnswer = highwayRemoveStation(highway, stationID);
+            oracleAnswer = removeModelStation(&model, stationID);
+        } else if(choice == 2 || choice == 3) {
+            stationID = randomStationID(&model, &workload);
+            cars[0] = randomBelow(&workload, workload.maxRange + 1);
+            libraryAnswer = highwayAddCar(highway, stationID, cars[0]);
+            oracleAnswer = addModelCar(&model, stationID, cars[0]);
+        } else if(choice == 4) {
+            stationID = randomStationID(&model, &workload);
+            i = findModelStation(&model, stationID);
+            // Usually one of the cars of the station, so that the removal succeeds
+            if(i < model.numberOfStations && model.stations[i].stationID == stationID && model.stations[i].numberOfCars > 0 &&
+               randomBelow(&workload, 4) > 0)
+                cars[0] = model.stations[i].cars[randomBelow(&workload, model.stations[i].numberOfCars)];
+            else
+                cars[0] = randomBelow(&workload, workload.maxRange + 1);
+            libraryAnswer = highwayRemoveCar(highway, stationID, cars[0]);
+            oracleAnswer = removeModelCar(&model, stationID, cars[0]);
+        } else {
+            start = randomStationID(&model, &workload);
+            end = randomStationID(&model, &workload);
+            // Half of the routes end close to their start, some of them very close, the others usually cross most of the highway
+            if(model.numberOfStations > 0 && randomBelow(&workload, 2) == 0) {
+                choice = randomBelow(&workload, 3) == 0 ? CLOSE_STATIONS : NEARBY_STATIONS;
+                i = findModelStation(&model, start) + (int) randomBelow(&workload, 2 * choice + 1) - choice;
+                i = i < 0 ? 0 : i >= model.numberOfStations ? model.numberOfStations - 1 : i;
+                end = model.stations[i].stationID;
+            }
+            // The stops are counted first, so a stale jump index is charged for every route it would have counted
+            clock_gettime(CLOCK_MONOTONIC, &before);
+            libraryCount = highwayCountStops(highway, start, end);
+            libraryAnswer = highwayPlanRoute(highway, start, end, libraryStops, model.capacity);
+            clock_gettime(CLOCK_MONOTONIC, &middle);
+            oracleAnswer = oracleRoute(&model, start, end, oracleStops, &listed);
+            clock_gettime(CLOCK_MONOTONIC, &after);
+            libraryTime += elapsed(before, middle);
+            oracleTime += elapsed(middle, after);
+            queries++;
+            listedQueries += listed;
+            if(oracleAnswer > 0) {
+                routes++;
+                stops += oracleAnswer;
+            }
+            if(libraryAnswer == oracleAnswer && libraryCount == oracleAnswer &&
+               (oracleAnswer == 0 || checkRoute(&model, libraryStops, libraryAnswer, start, end)) &&
+               (!listed || memcmp(libraryStops, oracleStops, oracleAnswer * sizeof(unsigned int)) == 0))
+                continue;
+            fprintf(stderr, "seed %llu operation %ld: route from %u to %u, %d stops counted, %d expected\n",
+                    seed, operation, start, end, libraryCount, oracleAnswer);
+            fprintf(stderr, "library:");
+            for(i = 0; i < libraryAnswer; i++)
+                fprintf(stderr, " %u", libraryStops[i]);
+            if(listed) {
+                fprintf(stderr, "\noracle: ");
+                for(i = 0; i < oracleAnswer; i++)
+                    fprintf(stderr, " %u", oracleStops[i]);
+            }
+            fprintf(stderr, "\n");
+            exit(1);
+        }
+        if(libraryAnswer != oracleAnswer) {
+            fprintf(stderr, "seed %llu operation %ld: operation %d on station %u answered %d, expected %d\n",
+                    seed, operation, choice, stationID, libraryAnswer, oracleAnswer);
+            exit(1);
+        }
+    }
+
+    printf("seed %llu: %d stations, %ld queries, %ld routes with %.1f stops on average, %ld queries with every route listed\n",
+           seed, model.numberOfStations, queries, routes, routes > 0 ? (double) stops / routes : 0.0, listedQueries);
+    printf("library %.3f ms, oracle %.3f ms, speedup x%.1f\n", libraryTime / 1e6, oracleTime / 1e6,
+           libraryTime > 0 ? (double) oracleTime / libraryTime : 0.0);
+
+    freeHighway(highway);
+    for(i = 0; i < model.numberOfStations; i++)
+        free(model.stations[i].cars);
+    free(model.stations);
+    free(model.distance);
+    free(model.queue);
+    free(model.reach);
+    free(model.levelStart);
+    free(model.ways);
+    free(model.route);
+    free(libraryStops);
+    free(oracleStops);
+    return 0;
+}
+
+/* Functions */
+unsigned long long nextRandom(Workload* workload) {
+    unsigned long long value = (workload->random += 0x9E3779B97F4A7C15ULL);
+
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+unsigned int randomBelow(Workload* workload, unsigned int bound) {
+    return (unsigned int) (nextRandom(workload) % bound);
+}
+
+void* allocate(size_t size) {
+    void* memory = malloc(size > 0 ? size : 1);
+
+    if(memory == NULL)
+        exit(3);
+    return memory;
+}
+
+int findModelStation(Model* model, unsigned int stationID) {
+    int low = 0;
+    int high = model->numberOfStations;
+    int middle;
+
+    while(low < high) {
+        middle = (low + high) / 2;
+        if(model->stations[middle].stationID < stationID)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+int addModelStation(Model* model, unsigned int stationID, const unsigned int* cars, int numberOfCars) {
+    int position = findModelStation(model, stationID);
+    ModelStation* station;
+
+    if(position < model->numberOfStations && model->stations[position].stationID == stationID)
+        return 0;
+    memmove(&model->stations[position + 1], &model->stations[position], (model->numberOfStations - position) * sizeof(ModelStation));
+    model->numberOfStations++;
+    station = &model->stations[position];
+    station->stationID = stationID;
+    station->capacity = numberOfCars > 0 ? numberOfCars : 1;
+    station->cars = allocate(station->capacity * sizeof(unsigned int));
+    station->numberOfCars = numberOfCars;
+    memcpy(station->cars, cars, numberOfCars * sizeof(unsigned int));
+    return 1;
+}
+
+int removeModelStation(Model* model, unsigned int stationID) {
+    int position = findModelStation(model, stationID);
+
+    if(position == model->numberOfStations || model->stations[position].stationID != stationID)
+        return 0;
+    free(model->stations[position].cars);
+    model->numberOfStations--;
+    memmove(&model->stations[position], &model->stations[position + 1], (model->numberOfStations - position) * sizeof(ModelStation));
+    return 1;
+}
+
+int addModelCar(Model* model, unsigned int stationID, unsigned int carID) {
+    int position = findModelStation(model, stationID);
+    ModelStation* station;
+
+    if(position == model->numberOfStations || model->stations[position].stationID != stationID)
+        return 0;
+    station = &model->stations[position];
+    if(station->numberOfCars == station->capacity) {
+        station->capacity *= 2;
+        station->cars = realloc(station->cars, station->capacity * sizeof(unsigned int));
+        if(station->cars == NULL)
+            exit(3);
+    }
+    station->cars[station->numberOfCars++] = carID;
+    return 1;
+}
+
+int removeModelCar(Model* model, unsigned int stationID, unsigned int carID) {
+    int position = findModelStation(model, stationID);
+    ModelStation* station;
+    int i;
+
+    if(position == model->numberOfStations || model->stations[position].stationID != stationID)
+        return 0;
+    station = &model->stations[position];
+    for(i = 0; i < station->numberOfCars; i++) {
+        if(station->cars[i] == carID) {
+            station->cars[i] = station->cars[--station->numberOfCars];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int reaches(Model* model, int from, int to) {
+    if(to > from)
+        return model->stations[to].stationID - model->stations[from].stationID <= model->reach[from];
+    return model->stations[from].stationID - model->stations[to].stationID <= model->reach[from];
+}
+
+int oracleRoute(Model* model, unsigned int start, unsigned int end, unsigned int* stops, int* listed) {
+    int first = findModelStation(model, start);
+    int last = findModelStation(model, end);
+    int direction = start < end ? 1 : -1;
+    int head = 0;
+    int tail = 0;
+    int numberOfStops = 0;
+    int found = 0;
+    int current;
+    int position;
+    int level;
+    int i, j;
+
+    *listed = 0;
+    if(first == model->numberOfStations || model->stations[first].stationID != start ||
+       last == model->numberOfStations || model->stations[last].stationID != end)
+        return 0;
+
+    // The reach of every station between start and end, from its cars
+    for(position = first; position != last + direction; position += direction) {
+        model->reach[position] = 0;
+        for(i = 0; i < model->stations[position].numberOfCars; i++)
+            if(model->stations[position].cars[i] > model->reach[position])
+                model->reach[position] = model->stations[position].cars[i];
+    }
+
+    // Breadth first search, a station reaches every following station towards end not further than its largest range
+    model->distance[first] = 0;
+    model->queue[tail++] = first;
+    while(head < tail && model->distance[last] < 0) {
+        current = model->queue[head++];
+        for(position = current + direction; position != last + direction; position += direction) {
+            if(!reaches(model, current, position))
+                break;
+            if(model->distance[position] < 0) {
+                model->distance[position] = model->distance[current] + 1;
+                model->queue[tail++] = position;
+            }
+        }
+    }
+
+    if(model->distance[last] >= 0) {
+        numberOfStops = model->distance[last] + 1;
+        // The stations of each distance are next to each other in the queue, every distance before end is complete
+        for(i = 0, level = 0; level < numberOfStops; level++) {
+            model->levelStart[level] = i;
+            while(i < tail && model->distance[model->queue[i]] == level)
+                i++;
+        }
+        model->levelStart[numberOfStops] = i;
+
+        // Routes with the fewest stops from each station to end, counted from end backwards
+        model->ways[last] = 1;
+        for(level = numberOfStops - 2; level >= 0; level--) {
+            for(i = model->levelStart[level]; i < model->levelStart[level + 1]; i++) {
+                current = model->queue[i];
+                model->ways[current] = 0;
+                for(j = model->levelStart[level + 1]; j < model->levelStart[level + 2]; j++) {
+                    position = level + 1 == numberOfStops - 1 ? last : model->queue[j];
+                    if(model->ways[position] > 0 && reaches(model, current, position))
+                        model->ways[current] += model->ways[position];
+                    if(model->ways[current] > MAX_LISTED_ROUTES)
+                        model->ways[current] = MAX_LISTED_ROUTES + 1;
+                    if(position == last)
+                        break;
+                }
+            }
+        }
+
+        if(model->ways[first] <= MAX_LISTED_ROUTES) {
+            listRoutes(model, first, 0, last, stops, &found);
+            *listed = 1;
+        }
+    }
+
+    for(i = 0; i < tail; i++)
+        model->distance[model->queue[i]] = -1;
+    return numberOfStops;
+}
+
+void listRoutes(Model* model, int current, int level, int last, unsigned int* stops, int* found) {
+    int lastLevel = model->distance[last];
+    int position;
+    int i;
+
+    model->route[level] = model->stations[current].stationID;
+    if(current == last) {
+        if(!*found || preferredRoute(model->route, stops, level + 1)) {
+            memcpy(stops, model->route, (level + 1) * sizeof(unsigned int));
+            *found = 1;
+        }
+        return;
+    }
+    for(i = model->levelStart[level + 1]; i < model->levelStart[level + 2]; i++) {
+        position = level + 1 == lastLevel ? last : model->queue[i];
+        if(model->ways[position] > 0 && reaches(model, current, position))
+            listRoutes(model, position, level + 1, last, stops, found);
+        if(position == last)
+            break;
+    }
+}
+
+int preferredRoute(const unsigned int* route, const unsigned int* other, int numberOfStops) {
+    int i;
+
+    for(i = numberOfStops - 2; i > 0; i--)
+        if(route[i] != other[i])
+            return route[i] < other[i];
+    return 0;
+}
+
+int checkRoute(Model* model, const unsigned int* stops, int numberOfStops, unsigned int start, unsigned int end) {
+    int previous = -1;
+    int position;
+    int i;
+
+    if(numberOfStops < 1 || stops[0] != start || stops[numberOfStops - 1] != end)
+        return 0;
+    for(i = 0; i < numberOfStops; i++) {
+        position = findModelStation(model, stops[i]);
+        if(position == model->numberOfStations || model->stations[position].stationID != stops[i])
+            return 0;
+        if(i > 0 && ((start < end ? stops[i] <= stops[i - 1] : stops[i] >= stops[i - 1]) || !reaches(model, previous, position)))
+            return 0;
+        previous = position;
+    }
+    return 1;
+}
+
+unsigned int randomStationID(Model* model, Workload* workload) {
+    if(model->numberOfStations == 0 || randomBelow(workload, 10) == 0)
+        return randomBelow(workload, workload->span + 1);
+    return model->stations[randomBelow(workload, model->numberOfStations)].stationID;
+}
+
+long long elapsed(struct timespec from, struct timespec to) {
+    return (long long) (to.tv_sec - from.tv_sec) * 1000000000LL + (to.tv_nsec - from.tv_nsec);
+}